@@ -0,0 +1,416 @@
+#pragma once
+
+/// ---------------------------------------------------------------------
+/// every allocator compared, behind the one adapter interface
+/// see dbj_benchmarking/allocator_registry.h
+///
+/// to add an allocator to all the comparisons: write its adapter
+/// in here and register it in the registry bellow
+///
+#include "common.h"
+#include "dbj_benchmarking/allocator_registry.h"
+
+#define DBJ_KMEM_SAMPLING
+#ifdef DBJ_KMEM_SAMPLING
+#include "kalloc/dbj_kalloc.h"
+#endif // DBJ_KMEM_SAMPLING
+
+#include "nvwa/fixed_mem_pool.h"
+#include "nvwa/static_mem_pool.h"
+
+#include "shoshnikov_pool_allocator/shoshnikov_pool_allocator.h"
+#include "dbj_pool_allocator/dbj_shoshnikov_pool_allocator.h"
+#include "dbj_pool_allocator/dbj_concurrent_pool_allocator.h"
+#include "dbj_pool_allocator/dbj_pools.h"
+#include "dbj_pool_allocator/dbj_static_pool.h"
+/// ---------------------------------------------------------------------
+/// nedmalloc primary purpose is multithreaded applications
+/// it is also notoriously difficult to use in its raw form
+///
+#define  NEDMALLOC_DEBUG 0
+#undef   ENABLE_LOGGING  /* 0xffffffff  */
+#define  NEDMALLOC_TESTLOGENTRY 0
+#define NO_NED_NAMESPACE
+#include "nedmalloc/nedmalloc.h"
+
+namespace allocator_adapters {
+
+	using dbj::bench::allocator_stats;
+
+	/// the object type the nvwa fixed size pools are instantiated for
+	template<size_t N>
+	struct payload final { char data_[N]; };
+
+	/// ---------------------------------------------------------------------
+	/// fixed size pools take the chunk size as the template argument
+	/// and the number of chunks in one block taken from the system
+	/// they serve sizes up to the chunk size
+	/// ---------------------------------------------------------------------
+
+#ifdef DBJ_KMEM_SAMPLING
+	/// each instance is its own arena, not the k_memory_() one
+	/// kalloc does not give memory back before km_destroy
+	struct kmem_adapter final {
+		/// kmalloc() gives addresses which are 8 mod 16
+		constexpr static size_t max_align = sizeof(size_t);
+
+		static const char* name() { return "KMEM"; }
+
+		kmem_adapter() noexcept : kmem_(km_init()) {}
+		~kmem_adapter() { km_destroy(kmem_); }
+
+		kmem_adapter(kmem_adapter const&) = delete;
+		kmem_adapter& operator = (kmem_adapter const&) = delete;
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(align_ <= max_align); (void)align_;
+			return kmalloc(kmem_, size_);
+		}
+		void deallocate(void* p_, size_t) { kfree(kmem_, p_); }
+
+		/// km_stat walks the free list
+		allocator_stats stats() const {
+			km_stat_t stat_{};
+			km_stat(kmem_, &stat_);
+			return { stat_.capacity, stat_.available, stat_.n_cores };
+		}
+	private:
+		void* kmem_{};
+	};
+#endif // DBJ_KMEM_SAMPLING
+
+	/// ---------------------------------------------------------------------
+	/// one singleton per size, blocks are taken from the system one by one
+	/// class_level_lock, one mutex per pool
+	template<size_t CHUNK_SIZE>
+	struct nvwa_static_adapter final {
+		using pool = nvwa::static_mem_pool<CHUNK_SIZE>;
+
+		constexpr static size_t max_size = CHUNK_SIZE;
+		constexpr static size_t max_align = MEM_POOL_ALIGNMENT;
+		constexpr static bool thread_safe = true;
+		constexpr static bool singleton = true;
+
+		static const char* name() { return "NVWA Static"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(size_ <= max_size); (void)size_;
+			_ASSERTE(align_ <= max_align); (void)align_;
+			return pool::instance_known().allocate();
+		}
+		void deallocate(void* p_, size_t) { pool::instance_known().deallocate(p_); }
+	};
+
+	/// ---------------------------------------------------------------------
+	/// one block of CHUNKS_PER_BLOCK chunks, made on construction
+	/// it does not grow, allocate() returns null when it is exhausted
+	/// the pool is static, one instance of the adapter at the time
+	/// its alignment is MEM_POOL_ALIGNMENT, unless fixed_mem_pool<T>::alignment
+	/// is specialized for payload<CHUNK_SIZE>; the block is malloc-ed, thus
+	/// the chunks are not aligned beyond max_align_t whatever that says
+	template<size_t CHUNK_SIZE, size_t CHUNKS_PER_BLOCK>
+	struct nvwa_fixed_adapter final {
+		using pool = nvwa::fixed_mem_pool< payload<CHUNK_SIZE> >;
+
+		constexpr static size_t max_size = CHUNK_SIZE;
+		constexpr static size_t max_align = pool::alignment::value < alignof(max_align_t)
+			? pool::alignment::value : alignof(max_align_t);
+		constexpr static bool thread_safe = true;
+		constexpr static bool singleton = true;
+
+		static const char* name() { return "NVWA"; }
+
+		nvwa_fixed_adapter() noexcept {
+			pool::initialize(CHUNKS_PER_BLOCK);
+			_ASSERTE(true == pool::is_initialized());
+		}
+		/// non zero is the number of chunks not given back, the pool is
+		/// then not freed and the next initialize() would assert
+		~nvwa_fixed_adapter() {
+			const int not_freed_ = pool::deinitialize();
+			_ASSERTE(not_freed_ == 0); (void)not_freed_;
+		}
+
+		nvwa_fixed_adapter(nvwa_fixed_adapter const&) = delete;
+		nvwa_fixed_adapter& operator = (nvwa_fixed_adapter const&) = delete;
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(size_ <= max_size); (void)size_;
+			_ASSERTE(align_ <= max_align); (void)align_;
+			return pool::allocate();
+		}
+		void deallocate(void* p_, size_t) { pool::deallocate(p_); }
+
+		/// the allocation count is not read, it is not guarded by the pool lock
+		allocator_stats stats() const {
+			return { CHUNKS_PER_BLOCK * pool::block_size::value, 0, 1 };
+		}
+	};
+
+	/// ---------------------------------------------------------------------
+	/// the pool gives its blocks back when destroyed, thus each adapter
+	/// owns one, as the other pools do
+	template<size_t CHUNK_SIZE, size_t CHUNKS_PER_BLOCK>
+	struct shoshnikov_adapter final {
+
+		constexpr static size_t max_size = CHUNK_SIZE;
+		constexpr static size_t max_align = sizeof(void*);
+
+		static const char* name() { return "Shoshnikov"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(size_ <= max_size); (void)size_;
+			_ASSERTE(align_ <= max_align); (void)align_;
+			return pool_.allocate(CHUNK_SIZE);
+		}
+		void deallocate(void* p_, size_t) { pool_.deallocate(p_); }
+
+		allocator_stats stats() const {
+			return { pool_.footprint(), 0, pool_.block_count() };
+		}
+
+	private:
+		dbj::nanolib::PoolAllocator  pool_{ CHUNKS_PER_BLOCK, CHUNK_SIZE };
+	};
+
+	/// ---------------------------------------------------------------------
+	/// empty blocks are given back when there are more than HIGH_WATER
+	/// of them, LOW_WATER are kept; by default never
+	/// HUGE_PAGES: blocks are mapped, 2 MiB aligned, see dbj_block_source.h
+	/// ALIGNMENT: of the chunks, see dbj::shohnikov::chunk_alignment
+	template<size_t CHUNK_SIZE, size_t CHUNKS_PER_BLOCK,
+		size_t HIGH_WATER = SIZE_MAX, size_t LOW_WATER = 0,
+		dbj::shohnikov::free_list_policy FREE_LIST = dbj::shohnikov::free_list_policy::lifo,
+		bool HUGE_PAGES = false,
+		size_t ALIGNMENT = sizeof(dbj::shohnikov::word_t)>
+	struct dbj_pool_adapter final {
+
+		static_assert(CHUNKS_PER_BLOCK >= 4 && CHUNKS_PER_BLOCK <= 65536 &&
+			(CHUNKS_PER_BLOCK & (CHUNKS_PER_BLOCK - 1)) == 0,
+			"not a dbj::shohnikov::legal_block_size");
+		static_assert(ALIGNMENT >= sizeof(dbj::shohnikov::word_t) &&
+			ALIGNMENT <= dbj::shohnikov::block_source::page_size &&
+			(ALIGNMENT & (ALIGNMENT - 1)) == 0,
+			"not a dbj::shohnikov::chunk_alignment");
+
+		constexpr static size_t max_size = CHUNK_SIZE;
+		constexpr static size_t max_align = ALIGNMENT;
+
+		static const char* name() {
+			static const std::string name_ = std::string("DBJ*Shoshnikov")
+				+ (FREE_LIST == dbj::shohnikov::free_list_policy::per_block ? " per block" : "")
+				+ (HIGH_WATER == SIZE_MAX ? "" : " sweeping")
+				+ (HUGE_PAGES ? " huge pages" : "")
+				+ (ALIGNMENT == sizeof(dbj::shohnikov::word_t) ? "" : " aligned " + std::to_string(ALIGNMENT));
+			return name_.c_str();
+		}
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(size_ <= max_size); (void)size_;
+			_ASSERTE(align_ <= max_align); (void)align_;
+			return pool_.allocate();
+		}
+		void deallocate(void* p_, size_t) { pool_.deallocate(p_); }
+
+		allocator_stats stats() const {
+			return { pool_.footprint(), 0, pool_.block_count() };
+		}
+
+	private:
+		dbj::shohnikov::dbj_pool_allocator  pool_{
+			dbj::shohnikov::legal_block_size(CHUNKS_PER_BLOCK), CHUNK_SIZE,
+			dbj::shohnikov::chunk_alignment{ ALIGNMENT },
+			dbj::shohnikov::sweep_policy{ HIGH_WATER, LOW_WATER }, FREE_LIST,
+			HUGE_PAGES ? dbj::shohnikov::block_source::huge() : dbj::shohnikov::block_source::heap()
+		};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// chunk size and block geometry are compile time constants
+	template<size_t CHUNK_SIZE, size_t CHUNKS_PER_BLOCK>
+	struct dbj_static_pool_adapter final {
+
+		constexpr static size_t max_size = CHUNK_SIZE;
+		constexpr static size_t max_align = sizeof(void*);
+
+		static const char* name() { return "DBJ static_pool"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(size_ <= max_size); (void)size_;
+			_ASSERTE(align_ <= max_align); (void)align_;
+			return pool_.allocate();
+		}
+		void deallocate(void* p_, size_t) { pool_.deallocate(p_); }
+
+		allocator_stats stats() const {
+			return { pool_.footprint(), 0, pool_.block_count() };
+		}
+
+	private:
+		dbj::shohnikov::static_pool<payload<CHUNK_SIZE>, CHUNKS_PER_BLOCK>  pool_{};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// per thread magazines over the lock free depot
+	template<size_t CHUNK_SIZE, size_t CHUNKS_PER_BLOCK>
+	struct dbj_concurrent_pool_adapter final {
+
+		static_assert(CHUNKS_PER_BLOCK >= 4 && CHUNKS_PER_BLOCK <= 65536 &&
+			(CHUNKS_PER_BLOCK & (CHUNKS_PER_BLOCK - 1)) == 0,
+			"not a dbj::shohnikov::legal_block_size");
+
+		constexpr static size_t max_size = CHUNK_SIZE;
+		constexpr static size_t max_align = sizeof(dbj::shohnikov::word_t);
+		constexpr static bool thread_safe = true;
+
+		static const char* name() { return "DBJ*Shoshnikov MT"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(size_ <= max_size); (void)size_;
+			_ASSERTE(align_ <= max_align); (void)align_;
+			return pool_.allocate();
+		}
+		void deallocate(void* p_, size_t) { pool_.deallocate(p_); }
+
+		allocator_stats stats() const {
+			return { pool_.footprint(), 0, pool_.block_count() };
+		}
+
+	private:
+		dbj::shohnikov::dbj_concurrent_pool_allocator  pool_{
+			dbj::shohnikov::legal_block_size(CHUNKS_PER_BLOCK), CHUNK_SIZE
+		};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// general purpose allocators
+	/// ---------------------------------------------------------------------
+	/// size classes, each a dbj pool, larger sizes go to the system
+	/// the stats are of the pools only
+	struct dbj_pools_adapter final {
+		static const char* name() { return "DBJ pools"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(align_ <= alignof(max_align_t)); (void)align_;
+			return pools_.malloc(size_);
+		}
+		void deallocate(void* p_, size_t) { pools_.free(p_); }
+
+		allocator_stats stats() const {
+			return { pools_.footprint(), 0, pools_.block_count() };
+		}
+
+	private:
+		dbj::shohnikov::dbj_pools pools_{};
+	};
+
+	struct heap_alloc_adapter final {
+		constexpr static bool thread_safe = true;
+		static const char* name() { return "HeapAlloc / HeapFree"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(align_ <= alignof(max_align_t)); (void)align_;
+			return (void*)DBJ_NANO_MALLOC(char, size_);
+		}
+		void deallocate(void* p_, size_t) { DBJ_NANO_FREE(p_); }
+	};
+
+	struct new_delete_adapter final {
+		constexpr static bool thread_safe = true;
+		static const char* name() { return "new [] / delete []"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(align_ <= alignof(max_align_t)); (void)align_;
+			return (void*)new char[size_];
+		}
+		void deallocate(void* p_, size_t) { delete[](char*)p_; }
+	};
+
+	struct ned_adapter final {
+		constexpr static bool thread_safe = true;
+		static const char* name() { return "NED14"; }
+
+		ned_adapter() noexcept = default;
+		/// the adapter lives for one scenario, free memory is given back after it
+		~ned_adapter() { ::nedmalloc_trim(0); }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(align_ <= alignof(max_align_t)); (void)align_;
+			return ::nedmalloc(size_);
+		}
+		void deallocate(void* p_, size_t) { ::nedfree(p_); }
+
+		allocator_stats stats() const {
+			const struct nedmallinfo info_ = ::nedmallinfo();
+			return { (size_t)::nedmalloc_footprint(), info_.fordblks, 0 };
+		}
+	};
+
+	/// currently, I probably have no clue
+	/// what are the good values here
+	/// DBJ_TESTING_NED_POOL puts it in the registry, pmr_comparisons.h uses it anyway
+	struct ned_pool_adapter final {
+		constexpr static bool thread_safe = true;
+		static const char* name() { return "NED14 Pool"; }
+
+		ned_pool_adapter() noexcept : pool_(::nedcreatepool(0, 0)) {}
+		~ned_pool_adapter() {
+			::neddestroypool(pool_);
+			// also not sure if this is necessary
+			::neddisablethreadcache(0);
+		}
+
+		ned_pool_adapter(ned_pool_adapter const&) = delete;
+		ned_pool_adapter& operator = (ned_pool_adapter const&) = delete;
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(align_ <= alignof(max_align_t)); (void)align_;
+			return ::nedpmalloc(pool_, size_);
+		}
+		void deallocate(void* p_, size_t) { ::nedpfree(pool_, p_); }
+
+		allocator_stats stats() const {
+			const struct nedmallinfo info_ = ::nedpmallinfo(pool_);
+			return { (size_t)::nedpmalloc_footprint(pool_), info_.fordblks, 0 };
+		}
+	private:
+		nedpool* pool_{};
+	};
+
+	struct malloc_adapter final {
+		constexpr static bool thread_safe = true;
+		static const char* name() { return "malloc / free"; }
+
+		void* allocate(size_t size_, size_t align_) {
+			_ASSERTE(align_ <= alignof(max_align_t)); (void)align_;
+			return ::malloc(size_);
+		}
+		void deallocate(void* p_, size_t) { ::free(p_); }
+	};
+
+	/// ---------------------------------------------------------------------
+	/// all the specimens, in the order of reporting
+	/// scenarios which can not use fixed size pools filter them out by
+	/// dbj::bench::adapter_traits<A>::general_purpose
+	template<size_t CHUNK_SIZE, size_t CHUNKS_PER_BLOCK = 64>
+	using registry = dbj::bench::allocator_registry<
+#ifdef DBJ_KMEM_SAMPLING
+		kmem_adapter,
+#endif // DBJ_KMEM_SAMPLING
+		nvwa_static_adapter<CHUNK_SIZE>,
+		nvwa_fixed_adapter<CHUNK_SIZE, CHUNKS_PER_BLOCK>,
+		shoshnikov_adapter<CHUNK_SIZE, CHUNKS_PER_BLOCK>,
+		dbj_pool_adapter<CHUNK_SIZE, CHUNKS_PER_BLOCK>,
+		dbj_static_pool_adapter<CHUNK_SIZE, CHUNKS_PER_BLOCK>,
+		dbj_concurrent_pool_adapter<CHUNK_SIZE, CHUNKS_PER_BLOCK>,
+		dbj_pools_adapter,
+		heap_alloc_adapter,
+		new_delete_adapter,
+		ned_adapter,
+#ifdef DBJ_TESTING_NED_POOL
+		ned_pool_adapter,
+#endif // DBJ_TESTING_NED_POOL
+		malloc_adapter
+	>;
+
+} // namespace allocator_adapters
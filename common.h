@@ -36,41 +36,90 @@
 #include <assert.h>
 
 #include "dbj--nanolib/dbj++tu.h"
+#include "dbj_benchmarking/high_resolution_timing.h"
+#include "dbj_benchmarking/latency_histogram.h"
+#include "dbj_benchmarking/perf_counters.h"
+#include "dbj_benchmarking/results_sink.h"
 
 namespace dbj {
 
+	/// every sample is kept in the latency histogram
+	/// see dbj_benchmarking/latency_histogram.h
+	/// hardware counters are summed, if available
+	/// see dbj_benchmarking/perf_counters.h
 	struct collector final {
 		char name_[0xFF]{ 0 };
-		float min_{};
-		float max_{};
-		int count_{};
+		latency::histogram histogram_{};
+		perf::counter_totals counters_{};
 
-		explicit collector(const char* newname) noexcept : min_(0), max_(0), count_(0) {
+		explicit collector(const char* newname) {
 			strncpy_s(name_, newname, strlen(newname));
 		}
 
-		void add(float new_time_)
+		/// nanoseconds
+		void add(double new_time_)
 		{
-			if (count_ == 0) {
-				min_ = new_time_;
-				max_ = new_time_;
-				count_ += 1;
-				return;
-			}
-			count_ += 1;
-			if (new_time_ < min_)
-				min_ = new_time_;
-			else if (new_time_ > max_)
-				max_ = new_time_;
-			else {/* no op */ }
+			histogram_.record(new_time_);
 		}
 
-		static void report(collector& clctr_, void (*cb) (const char*, float, float, int)) {
-			cb(clctr_.name_, clctr_.min_, clctr_.max_, clctr_.count_);
+		/// operations_ is how many operations the measurement was made of
+		void add_counters(perf::counter_values const& values_, uint64_t operations_)
+		{
+			counters_.add(values_, operations_);
+		}
+
+		latency::summary summary() const noexcept { return histogram_.summarize(); }
+
+		static void report(collector& clctr_,
+			void (*cb) (const char*, latency::summary const&, perf::counter_totals const&)) {
+			cb(clctr_.name_, clctr_.summary(), clctr_.counters_);
 		}
 
 	};
 	/// ---------------------------------------------------------------------
+	/// the common part of all the reporters
+	inline void print_summary(latency::summary const& sum_)
+	{
+		using latency::to_text;
+		DBJ_PRINT("mean: %s, stddev: %s, coefficient of variation: %6.2f%%",
+			to_text(sum_.mean).text, to_text(sum_.stddev).text, 100 * sum_.cv);
+		DBJ_PRINT("p50: %s, p90: %s, p99: %s, p99.9: %s, max: " DBJ_FG_RED_BOLD "%s" DBJ_RESET,
+			to_text(sum_.p50).text, to_text(sum_.p90).text, to_text(sum_.p99).text,
+			to_text(sum_.p999).text, to_text(sum_.max).text);
+	}
+	/// ---------------------------------------------------------------------
+	/// one line, only the counters available, nothing if none is
+	inline void print_counters(perf::counter_totals const& totals_, const char* prefix_ = "")
+	{
+		using perf::counter;
+		if (!totals_.any()) return;
+
+		char line_[0x200]{};
+		int len_ = snprintf(line_, sizeof(line_), "%sper op --", prefix_);
+		for (unsigned j = 0; j < perf::counter_count; ++j) {
+			if (!totals_.available[j]) continue;
+			len_ += snprintf(line_ + len_, sizeof(line_) - len_, " %s: %.2f,",
+				perf::counter_names[j], totals_.per_op(counter(j)));
+		}
+		if (totals_.has(counter::cycles) && totals_.has(counter::instructions) && totals_.sum[unsigned(counter::cycles)] > 0)
+			snprintf(line_ + len_, sizeof(line_) - len_, " IPC: %.2f",
+				totals_.sum[unsigned(counter::instructions)] / totals_.sum[unsigned(counter::cycles)]);
+		else
+			line_[len_ - 1] = '\0';
+
+		DBJ_PRINT("%s", line_);
+	}
+
+	/// per operation counter values, for the results records
+	inline std::vector<results::metric> counter_metrics(perf::counter_totals const& totals_)
+	{
+		std::vector<results::metric> metrics_{};
+		for (unsigned j = 0; j < perf::counter_count; ++j)
+			if (totals_.available[j])
+				metrics_.push_back({ perf::counter_keys[j], totals_.per_op(perf::counter(j)) });
+		return metrics_;
+	}
+	/// ---------------------------------------------------------------------
 	static inline int randomizer(int max_ = 0xFF, int min_ = 1)
 	{
 		static auto _ = [] {
@@ -80,14 +129,19 @@ namespace dbj {
 		return (rand() % max_ + min_);
 	}
 	/// ---------------------------------------------------------------------
-	static inline auto driver = [](collector& clctr_, auto specimen)
+	/// clock() was used here before, it could not resolve anything
+	/// shorter than a big batch; see dbj_benchmarking/high_resolution_timing.h
+	/// operations_ is how many allocations the specimen makes,
+	/// counters are reported per one
+	template<typename SPECIMEN>
+	inline void driver(collector& clctr_, SPECIMEN specimen, uint64_t operations_ = 1)
 	{
-		volatile clock_t time_point_ = clock();
-		specimen();
-		/// float rez = (float)(clock() - time_point_) / CLOCKS_PER_SEC;
-		clctr_.add((float)(clock() - time_point_) / CLOCKS_PER_SEC);
-		/// printf("%12s %.3f sec ", prompt_, rez);
-	};
+		perf::counter_group& counters_ = perf::counters();
+		timing::warm_up();
+		counters_.start();
+		clctr_.add(timing::engine::measure_ns(specimen));
+		clctr_.add_counters(counters_.stop(), operations_);
+	}
 }
 /// ---------------------------------------------------------------------
 #endif // __cplusplus
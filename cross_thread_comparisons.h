@@ -0,0 +1,205 @@
+#pragma once
+
+/// ---------------------------------------------------------------------
+/// blocks allocated on one thread are freed on another one
+/// producers allocate and push through a lock free ring
+/// consumers pop and free
+/// nedmalloc threadcache_free() and the isforeign paths in CallFree()
+/// are there exactly for this
+///
+/// throughput and the footprint growth over time are reported
+///
+#define MEM_ALLOC_CROSS_THREAD_COMPARISONS
+#ifdef MEM_ALLOC_CROSS_THREAD_COMPARISONS
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "comparisons.h"
+#include "dbj_benchmarking/mpmc_ring.h"
+
+namespace cross_thread_comparisons {
+
+#ifndef DBJ_CROSS_THREAD_PRODUCERS
+#define DBJ_CROSS_THREAD_PRODUCERS 2
+#endif
+#ifndef DBJ_CROSS_THREAD_CONSUMERS
+#define DBJ_CROSS_THREAD_CONSUMERS 2
+#endif
+
+	constexpr unsigned producers = DBJ_CROSS_THREAD_PRODUCERS, consumers = DBJ_CROSS_THREAD_CONSUMERS;
+
+	/// fixed size pools are instantiated for this size
+	constexpr size_t object_size = 64, ring_capacity = 0x1000;
+	/// the nvwa fixed pool does not grow, it has to hold
+	/// the full ring and the blocks in flight
+	constexpr size_t pool_chunks_per_block = 0x2000;
+	static_assert(ring_capacity + DBJ_CROSS_THREAD_PRODUCERS + DBJ_CROSS_THREAD_CONSUMERS <= pool_chunks_per_block);
+#ifdef NDEBUG
+	constexpr size_t blocks_per_producer = 0x100000;
+#else
+	constexpr size_t blocks_per_producer = 0x10000;
+#endif // NDEBUG
+
+	/// footprint is sampled by the main thread, while the lot runs
+	constexpr int sampling_interval_ms = 10;
+	/// timeline points printed
+	constexpr size_t timeline_points = 8;
+
+	struct footprint_sample final {
+		double ms{};
+		size_t bytes{};
+	};
+
+	/// ---------------------------------------------------------------------
+	inline void reporter(const char* name, double seconds_, std::vector<footprint_sample> const& samples_)
+	{
+		const double handoffs_ = double(producers) * blocks_per_producer;
+		DBJ_PRINT(DBJ_FG_RED_BOLD "%-24s" DBJ_RESET " %u producers, %u consumers, %8.3f sec, Mhandoffs/sec: %8.3f",
+			name, producers, consumers, seconds_, handoffs_ / seconds_ / 1e6);
+
+		dbj::results::record record_{ "cross_thread", name, object_size, producers + consumers, {},
+			{ { "seconds", seconds_ }, { "mhandoffs_per_sec", handoffs_ / seconds_ / 1e6 } } };
+
+		if (samples_.empty()) {
+			DBJ_PRINT("%-24s footprint not available", " ");
+			dbj::results::sink().add(std::move(record_));
+			return;
+		}
+
+		size_t peak_{};
+		for (auto const& s_ : samples_) if (s_.bytes > peak_) peak_ = s_.bytes;
+
+		record_.metrics.push_back({ "footprint_peak_bytes", double(peak_) });
+		record_.metrics.push_back({ "footprint_growth_bytes",
+			double(samples_.back().bytes) - double(samples_.front().bytes) });
+		dbj::results::sink().add(std::move(record_));
+
+		DBJ_PRINT("%-24s footprint KB -- first: %zu, peak: %zu, last: %zu, growth: %lld",
+			" ", samples_.front().bytes / 1024, peak_ / 1024, samples_.back().bytes / 1024,
+			(long long)(samples_.back().bytes / 1024) - (long long)(samples_.front().bytes / 1024));
+
+		printf("%-24s timeline  ", " ");
+		const size_t step_ = samples_.size() > timeline_points ? samples_.size() / timeline_points : 1;
+		for (size_t j = 0; j < samples_.size(); j += step_)
+			printf("| %6.0f ms: %zu KB ", samples_[j].ms, samples_[j].bytes / 1024);
+		DBJ_PRINT(" ");
+	}
+
+	/// ---------------------------------------------------------------------
+	/// footprint is sampled if the adapter has stats()
+	template<typename A>
+	inline void specimen(A& adapter_)
+	{
+		constexpr bool sample_footprint_ = dbj::bench::adapter_traits<A>::has_stats;
+		auto footprint_ = [&] { return dbj::bench::adapter_traits<A>::stats(adapter_).footprint; };
+
+		dbj::bench::mpmc_ring<void*> ring_(ring_capacity);
+
+		std::atomic<unsigned> ready_{ 0 };
+		std::atomic<bool> go_{ false };
+		std::atomic<unsigned> producers_done_{ 0 };
+		std::atomic<size_t> consumed_{ 0 };
+
+		std::vector<std::thread> threads_;
+		threads_.reserve(producers + consumers);
+
+		auto wait_for_go = [&] {
+			ready_.fetch_add(1);
+			while (!go_.load(std::memory_order_acquire)) std::this_thread::yield();
+		};
+
+		for (unsigned j = 0; j < producers; ++j)
+			threads_.emplace_back([&] {
+			wait_for_go();
+			for (size_t k = 0; k < blocks_per_producer; ++k) {
+				void* block_ = adapter_.allocate(object_size, alignof(void*));
+				*(size_t*)block_ = k;
+				while (!ring_.try_push(block_)) std::this_thread::yield();
+			}
+			producers_done_.fetch_add(1, std::memory_order_release);
+		});
+
+		for (unsigned j = 0; j < consumers; ++j)
+			threads_.emplace_back([&] {
+			wait_for_go();
+			void* block_{};
+			size_t count_{};
+			for (;;) {
+				// read before the pop, if all were done and the pop fails the ring is empty
+				const bool done_ = producers_done_.load(std::memory_order_acquire) == producers;
+				if (ring_.try_pop(block_)) {
+					adapter_.deallocate(block_, object_size);
+					++count_;
+				}
+				else if (done_) {
+					break;
+				}
+				else {
+					std::this_thread::yield();
+				}
+			}
+			consumed_.fetch_add(count_);
+		});
+
+		while (ready_.load() < producers + consumers) std::this_thread::yield();
+
+		std::vector<footprint_sample> samples_;
+		const dbj::timing::tick_type start_ = dbj::timing::engine::start();
+		go_.store(true, std::memory_order_release);
+
+		if (sample_footprint_) {
+			while (producers_done_.load() < producers) {
+				samples_.push_back({
+					dbj::timing::engine::elapsed_ns(start_, dbj::timing::engine::stop()) / 1e6,
+					footprint_() });
+				std::this_thread::sleep_for(std::chrono::milliseconds(sampling_interval_ms));
+			}
+		}
+
+		for (auto& t_ : threads_) t_.join();
+		const dbj::timing::tick_type stop_ = dbj::timing::engine::stop();
+
+		if (sample_footprint_)
+			samples_.push_back({ dbj::timing::engine::elapsed_ns(start_, stop_) / 1e6, footprint_() });
+
+		_ASSERTE(consumed_.load() == producers * blocks_per_producer);
+		reporter(adapter_.name(), dbj::timing::engine::elapsed_ns(start_, stop_) / 1e9, samples_);
+	}
+
+	/// ---------------------------------------------------------------------
+	/// allocators which are not thread safe are shared behind a mutex
+	inline void compare_cross_thread_mechanisms()
+	{
+		allocator_adapters::registry<object_size, pool_chunks_per_block>::for_each(
+			[](auto& adapter_) {
+				using A = std::decay_t<decltype(adapter_)>;
+
+				if constexpr (dbj::bench::adapter_traits<A>::thread_safe) {
+					specimen(adapter_);
+				}
+				else {
+					dbj::bench::locked_adapter<A> locked_(adapter_);
+					specimen(locked_);
+				}
+			});
+	}
+
+	/// ---------------------------------------------------------------------
+	inline void cross_thread_comparator()
+	{
+		DBJ_PRINT(" ");
+		DBJ_PRINT("Cross thread free: %u producers allocate %zu blocks of %zu bytes each,", producers, blocks_per_producer, object_size);
+		DBJ_PRINT("%u consumers free them, blocks are handed over through a lock free ring of %zu", consumers, ring_capacity);
+		DBJ_PRINT(" ");
+		dbj::timing::warm_up();
+		compare_cross_thread_mechanisms();
+	}
+
+	TUF_REG(cross_thread_comparator);
+
+} // namespace cross_thread_comparisons
+
+#endif // MEM_ALLOC_CROSS_THREAD_COMPARISONS
@@ -0,0 +1,100 @@
+#ifndef DBJ_ADAPTER_RESOURCE_INC
+#define DBJ_ADAPTER_RESOURCE_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ std::pmr::memory_resource over an allocator adapter, see allocator_registry.h
+
+ Thus every allocator of the registry can be given to the std::pmr
+ containers, instead of overloading operator new of the classes.
+
+	adapter_resource< allocator_adapters::dbj_pool_adapter<64, 0x400> > resource_ ;
+	std::pmr::list<int> list_( &resource_ ) ;
+
+ The resource owns the adapter. Requests larger than its max_size, or
+ aligned more than its max_align, go to the upstream resource, by default
+ std::pmr::new_delete_resource(). The fixed size pools thus serve the
+ nodes of the node based containers and the upstream serves the arrays,
+ vector storage and hash table buckets. do_deallocate() is given the same
+ size and alignment, thus it knows where the block came from.
+
+ allocate() returning null is out of memory, std::bad_alloc is thrown.
+ The adapter max_align is trusted, what it returns is asserted to be
+ aligned as asked.
+
+ Resources are equal only to themselves. Not thread safe, unless the
+ adapter is.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory_resource>
+#include <new>
+#include <string>
+
+#include "allocator_registry.h"
+
+namespace dbj::bench {
+
+	template<typename A>
+	struct adapter_resource final : std::pmr::memory_resource {
+
+		using traits = adapter_traits<A>;
+
+		explicit adapter_resource(std::pmr::memory_resource* upstream_arg = std::pmr::new_delete_resource()) noexcept
+			: upstream_(upstream_arg)
+		{
+		}
+
+		adapter_resource(adapter_resource const&) = delete;
+		adapter_resource& operator = (adapter_resource const&) = delete;
+
+		static const char* name() {
+			static const std::string name_ = std::string(A::name()) + " pmr";
+			return name_.c_str();
+		}
+
+		A& adapter() noexcept { return adapter_; }
+		A const& adapter() const noexcept { return adapter_; }
+		std::pmr::memory_resource* upstream() const noexcept { return upstream_; }
+
+		/// allocations the adapter could not serve
+		size_t upstream_count() const noexcept { return upstream_count_; }
+
+		/// the adapter serves it
+		constexpr static bool adapted(size_t bytes_, size_t alignment_) noexcept {
+			return bytes_ <= traits::max_size && alignment_ <= traits::max_align;
+		}
+
+	private:
+
+		void* do_allocate(size_t bytes_, size_t alignment_) override {
+			if (!adapted(bytes_, alignment_)) {
+				++upstream_count_;
+				return upstream_->allocate(bytes_, alignment_);
+			}
+			void* block_ = adapter_.allocate(bytes_, alignment_);
+			if (block_ == nullptr) throw std::bad_alloc();
+			_ASSERTE(((uintptr_t)block_ & (alignment_ - 1)) == 0);
+			return block_;
+		}
+
+		void do_deallocate(void* block_, size_t bytes_, size_t alignment_) override {
+			if (!adapted(bytes_, alignment_))
+				upstream_->deallocate(block_, bytes_, alignment_);
+			else
+				adapter_.deallocate(block_, bytes_);
+		}
+
+		bool do_is_equal(std::pmr::memory_resource const& other_) const noexcept override {
+			return this == &other_;
+		}
+
+		A adapter_{};
+		std::pmr::memory_resource* upstream_{};
+		size_t upstream_count_{};
+	}; // adapter_resource
+
+} // dbj::bench
+
+#endif // DBJ_ADAPTER_RESOURCE_INC
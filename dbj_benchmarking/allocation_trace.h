@@ -0,0 +1,371 @@
+#ifndef DBJ_ALLOCATION_TRACE_INC
+#define DBJ_ALLOCATION_TRACE_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Compact binary allocation trace.
+
+ header, followed by record_count records
+ each record is one allocation or one free
+
+ Block ids are dense, [0, id_count), so the replay keeps live blocks
+ in a plain array indexed by id. Writers renumber whatever identifies
+ the blocks in the source (usually the pointers) to such ids.
+
+ Traces are read through a read only memory mapping of the file.
+ A trace with a record id out of [0, id_count) is not valid.
+
+ Producers of the traces
+	- trace_writer, for any code which wants to record itself
+	- convert_nedmalloc_log(), nedmalloc with ENABLE_LOGGING writes csv logs
+	  on nedflushlogs(); those are converted to this format
+	- write_synthetic_trace(), randomized mixed size and lifetime workload
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dbj::trace {
+
+	enum class operation : uint8_t { allocate = 0, deallocate = 1 };
+
+#pragma pack(push, 1)
+	struct header final {
+		char magic[8]{ 'D','B','J','T','R','A','C','E' };
+		uint32_t version{ 1 };
+		uint32_t record_size{};
+		uint64_t record_count{};
+		uint64_t id_count{};
+	};
+
+	struct record final {
+		/// nanoseconds from the trace start
+		uint64_t timestamp{};
+		uint32_t id{};
+		uint32_t size{};
+		uint16_t thread{};
+		operation op{};
+		uint8_t reserved_[5]{};
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(header) == 32);
+	static_assert(sizeof(record) == 24);
+
+	/// ---------------------------------------------------------------------
+	/// read only, whole file mapping
+	class mapped_file final {
+		const void* data_{};
+		size_t size_{};
+#if defined(_WIN32)
+		HANDLE file_{ INVALID_HANDLE_VALUE };
+		HANDLE mapping_{};
+#endif
+	public:
+		explicit mapped_file(const char* path_) noexcept
+		{
+#if defined(_WIN32)
+			file_ = ::CreateFileA(path_, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file_ == INVALID_HANDLE_VALUE) return;
+			LARGE_INTEGER size_li_{};
+			if (!::GetFileSizeEx(file_, &size_li_) || size_li_.QuadPart == 0) return;
+			mapping_ = ::CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping_) return;
+			data_ = ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+			if (data_) size_ = size_t(size_li_.QuadPart);
+#else
+			const int fd_ = ::open(path_, O_RDONLY);
+			if (fd_ < 0) return;
+			struct stat st_ {};
+			if (::fstat(fd_, &st_) == 0 && st_.st_size > 0) {
+				void* map_ = ::mmap(nullptr, size_t(st_.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+				if (map_ != MAP_FAILED) {
+					data_ = map_;
+					size_ = size_t(st_.st_size);
+				}
+			}
+			// the mapping stays valid after the close
+			::close(fd_);
+#endif
+		}
+
+		~mapped_file()
+		{
+#if defined(_WIN32)
+			if (data_) ::UnmapViewOfFile(data_);
+			if (mapping_) ::CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE) ::CloseHandle(file_);
+#else
+			if (data_) ::munmap(const_cast<void*>(data_), size_);
+#endif
+		}
+
+		mapped_file(mapped_file const&) = delete;
+		mapped_file& operator = (mapped_file const&) = delete;
+
+		bool valid() const noexcept { return data_ != nullptr; }
+		const void* data() const noexcept { return data_; }
+		size_t size() const noexcept { return size_; }
+	};
+
+	/// ---------------------------------------------------------------------
+	/// records are used in place, from the mapping
+	class trace_view final {
+		mapped_file file_;
+		const header* header_{};
+		const record* records_{};
+	public:
+		explicit trace_view(const char* path_) noexcept : file_(path_)
+		{
+			if (!file_.valid() || file_.size() < sizeof(header)) return;
+			const header* h_ = static_cast<const header*>(file_.data());
+			if (memcmp(h_->magic, header{}.magic, sizeof(h_->magic)) != 0) return;
+			if (h_->record_size != sizeof(record)) return;
+			// record_count * sizeof(record) may overflow
+			if (h_->record_count > (file_.size() - sizeof(header)) / sizeof(record)) return;
+			// ids index the replay arrays, a truncated or edited trace is rejected
+			if (h_->id_count > h_->record_count) return;
+			const record* first_ = reinterpret_cast<const record*>(h_ + 1);
+			for (uint64_t j = 0; j < h_->record_count; ++j)
+				if (first_[j].id >= h_->id_count) return;
+			header_ = h_;
+			records_ = first_;
+		}
+
+		bool valid() const noexcept { return header_ != nullptr; }
+		size_t size() const noexcept { return valid() ? size_t(header_->record_count) : 0; }
+		size_t id_count() const noexcept { return valid() ? size_t(header_->id_count) : 0; }
+
+		const record* begin() const noexcept { return records_; }
+		const record* end() const noexcept { return records_ + size(); }
+	};
+
+	/// ---------------------------------------------------------------------
+	/// the header is rewritten with the final counts on close
+	class trace_writer final {
+		FILE* file_{};
+		header header_{};
+	public:
+		explicit trace_writer(const char* path_) noexcept
+		{
+			header_.record_size = sizeof(record);
+			file_ = fopen(path_, "wb");
+			if (file_) fwrite(&header_, sizeof(header_), 1, file_);
+		}
+
+		~trace_writer() { close(); }
+
+		trace_writer(trace_writer const&) = delete;
+		trace_writer& operator = (trace_writer const&) = delete;
+
+		bool valid() const noexcept { return file_ != nullptr; }
+
+		void write(record const& rec_) noexcept
+		{
+			if (!file_) return;
+			fwrite(&rec_, sizeof(rec_), 1, file_);
+			header_.record_count += 1;
+			if (uint64_t(rec_.id) + 1 > header_.id_count) header_.id_count = uint64_t(rec_.id) + 1;
+		}
+
+		void close() noexcept
+		{
+			if (!file_) return;
+			fseek(file_, 0, SEEK_SET);
+			fwrite(&header_, sizeof(header_), 1, file_);
+			fclose(file_);
+			file_ = nullptr;
+		}
+	};
+
+	/// ---------------------------------------------------------------------
+	/// renumbers whatever identifies blocks in the source to dense ids
+	/// freed ids are recycled, so the id space is the peak of live blocks
+	class id_map final {
+		std::unordered_map<uint64_t, uint32_t> live_{};
+		std::vector<uint32_t> free_ids_{};
+		uint32_t next_id_{};
+	public:
+		uint32_t on_allocate(uint64_t key_)
+		{
+			uint32_t id_{};
+			if (!free_ids_.empty()) {
+				id_ = free_ids_.back();
+				free_ids_.pop_back();
+			}
+			else {
+				id_ = next_id_++;
+			}
+			live_[key_] = id_;
+			return id_;
+		}
+
+		/// false if the key is not live
+		bool on_deallocate(uint64_t key_, uint32_t& id_)
+		{
+			auto it_ = live_.find(key_);
+			if (it_ == live_.end()) return false;
+			id_ = it_->second;
+			live_.erase(it_);
+			free_ids_.push_back(id_);
+			return true;
+		}
+
+		bool is_live(uint64_t key_) const { return live_.count(key_) > 0; }
+	};
+
+	/// ---------------------------------------------------------------------
+	/// nedmalloc csv log line
+	/// Timestamp, Pool, Operation, MSpace, Size, Block, Alignment, Flags, Returned,"Stack Backtrace"
+	/// *_MALLOC allocates Returned, *_FREE frees Block,
+	/// *_REALLOC frees Block and allocates Returned, the rest is ignored
+	/// there is no thread id in those logs, thread is always 0
+	/// returns the number of records written
+	inline size_t convert_nedmalloc_log(const char* csv_path_, const char* trace_path_)
+	{
+		FILE* csv_ = fopen(csv_path_, "r");
+		if (!csv_) return 0;
+		trace_writer writer_(trace_path_);
+		if (!writer_.valid()) { fclose(csv_); return 0; }
+
+		id_map ids_{};
+		size_t written_{};
+		uint64_t first_timestamp_{};
+		bool first_ = true;
+		char line_[0x1000]{};
+
+		auto field = [](char*& cursor_) -> char* {
+			while (*cursor_ == ' ') ++cursor_;
+			char* start_ = cursor_;
+			while (*cursor_ && *cursor_ != ',') ++cursor_;
+			if (*cursor_ == ',') *cursor_++ = '\0';
+			return start_;
+		};
+
+		while (fgets(line_, sizeof(line_), csv_)) {
+			char* cursor_ = line_;
+			const uint64_t timestamp_ = strtoull(field(cursor_), nullptr, 10);
+			(void)field(cursor_); // pool
+			const char* op_ = field(cursor_);
+			(void)field(cursor_); // mspace
+			const uint64_t size_ = strtoull(field(cursor_), nullptr, 10);
+			const uint64_t block_ = strtoull(field(cursor_), nullptr, 16);
+			(void)field(cursor_); // alignment
+			(void)field(cursor_); // flags
+			const uint64_t returned_ = strtoull(field(cursor_), nullptr, 16);
+
+			// the heading line is skipped here
+			if (strncmp(op_, "LOGENTRY_", 9) != 0) continue;
+
+			if (first_) { first_timestamp_ = timestamp_; first_ = false; }
+
+			record rec_{};
+			rec_.timestamp = timestamp_ - first_timestamp_;
+
+			const bool is_malloc_ = strstr(op_, "_MALLOC") != nullptr;
+			const bool is_free_ = strstr(op_, "_FREE") != nullptr;
+			const bool is_realloc_ = strstr(op_, "_REALLOC") != nullptr;
+
+			if ((is_free_ || is_realloc_) && block_) {
+				uint32_t id_{};
+				if (ids_.on_deallocate(block_, id_)) {
+					rec_.op = operation::deallocate;
+					rec_.id = id_;
+					writer_.write(rec_);
+					++written_;
+				}
+			}
+			if ((is_malloc_ || is_realloc_) && returned_ && !ids_.is_live(returned_)) {
+				rec_.op = operation::allocate;
+				rec_.id = ids_.on_allocate(returned_);
+				rec_.size = uint32_t(size_);
+				writer_.write(rec_);
+				++written_;
+			}
+		}
+		fclose(csv_);
+		return written_;
+	}
+
+	/// ---------------------------------------------------------------------
+	/// randomized mixed size, mixed lifetime workload
+	/// mostly small blocks, sometimes big ones, short and long lived
+	/// the seed is fixed, every run replays the same trace
+	/// timestamps are logical, one tick per record
+	inline size_t write_synthetic_trace(const char* trace_path_, size_t allocations_, uint32_t seed_ = 0xDB1)
+	{
+		trace_writer writer_(trace_path_);
+		if (!writer_.valid()) return 0;
+
+		std::mt19937 rng_(seed_);
+		// 16 bytes .. 128KB, geometric, small sizes are more probable
+		std::geometric_distribution<int> size_class_(0.35);
+		std::uniform_int_distribution<int> percent_(0, 99);
+
+		// ( dies at, key ), the one to die first on top
+		using live_block = std::pair<uint64_t, uint64_t>;
+		std::priority_queue<live_block, std::vector<live_block>, std::greater<live_block>> live_{};
+		id_map ids_{};
+		size_t written_{};
+		uint64_t clock_{};
+
+		auto free_first = [&] {
+			record rec_{};
+			rec_.timestamp = clock_++;
+			rec_.op = operation::deallocate;
+			uint32_t id_{};
+			ids_.on_deallocate(live_.top().second, id_);
+			rec_.id = id_;
+			writer_.write(rec_);
+			++written_;
+			live_.pop();
+		};
+
+		for (size_t j = 0; j < allocations_; ++j) {
+			int class_ = size_class_(rng_);
+			if (class_ > 12) class_ = 12;
+			const uint32_t base_ = 16U << class_;
+			const uint32_t size_ = base_ + uint32_t(rng_() % base_);
+
+			// 80% die young, 15% live a while, 5% live until the end
+			const int p_ = percent_(rng_);
+			const uint64_t lifetime_ = p_ < 80 ? 1 + rng_() % 64 : (p_ < 95 ? 1 + rng_() % 0x4000 : UINT64_MAX / 2);
+
+			record rec_{};
+			rec_.timestamp = clock_++;
+			rec_.op = operation::allocate;
+			rec_.size = size_;
+			// the allocation counter is the key, as if it was a pointer
+			rec_.id = ids_.on_allocate(j);
+			writer_.write(rec_);
+			++written_;
+			live_.push({ j + lifetime_, j });
+
+			while (!live_.empty() && live_.top().first <= j) free_first();
+		}
+		while (!live_.empty()) free_first();
+		return written_;
+	}
+
+} // dbj::trace
+
+#endif // DBJ_ALLOCATION_TRACE_INC
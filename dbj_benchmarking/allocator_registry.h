@@ -0,0 +1,248 @@
+#ifndef DBJ_ALLOCATOR_REGISTRY_INC
+#define DBJ_ALLOCATOR_REGISTRY_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Uniform allocator adapter interface and the compile time registry.
+
+ An adapter is a type with
+
+	static const char* name();
+	void* allocate(size_t size, size_t align);
+	void  deallocate(void* p, size_t size);
+
+ and optionally
+
+	allocator_stats stats() const;
+	constexpr static size_t max_size;    // fixed size pools, default: any size
+	constexpr static size_t max_align;   // default: alignof(max_align_t)
+	constexpr static bool   thread_safe; // default: false
+	constexpr static bool   singleton;   // all instances share one allocator, default: false
+
+ Adapters in the registry must be default constructible.
+ Scenarios iterate the registry and each of them runs over all the
+ allocators registered. Adding an allocator is adding one adapter.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace dbj::bench {
+
+	/// what the allocator took from the system, zeroes if it does not tell
+	struct allocator_stats final {
+		/// bytes taken from the system
+		size_t footprint{};
+		/// of those, bytes free to be allocated
+		size_t available{};
+		/// blocks, cores or segments taken from the system
+		size_t blocks{};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// C++17 detection idiom, in lieu of concepts
+	namespace detail {
+
+		template<typename A, typename = void>
+		struct is_adapter : std::false_type {};
+
+		template<typename A>
+		struct is_adapter<A, std::void_t<
+			decltype(A::name()),
+			decltype(std::declval<A&>().allocate(size_t{}, size_t{})),
+			decltype(std::declval<A&>().deallocate((void*)nullptr, size_t{}))
+			>> : std::bool_constant<
+			std::is_convertible_v<decltype(A::name()), const char*> &&
+			std::is_same_v<decltype(std::declval<A&>().allocate(size_t{}, size_t{})), void*>
+			> {};
+
+		template<typename A, typename = void>
+		struct has_stats : std::false_type {};
+
+		template<typename A>
+		struct has_stats<A, std::void_t<decltype(std::declval<A const&>().stats())>>
+			: std::is_same<decltype(std::declval<A const&>().stats()), allocator_stats> {};
+
+		template<typename A, typename = void>
+		struct max_size_of : std::integral_constant<size_t, SIZE_MAX> {};
+
+		template<typename A>
+		struct max_size_of<A, std::void_t<decltype(A::max_size)>>
+			: std::integral_constant<size_t, A::max_size> {};
+
+		template<typename A, typename = void>
+		struct max_align_of : std::integral_constant<size_t, alignof(max_align_t)> {};
+
+		template<typename A>
+		struct max_align_of<A, std::void_t<decltype(A::max_align)>>
+			: std::integral_constant<size_t, A::max_align> {};
+
+		template<typename A, typename = void>
+		struct thread_safe_of : std::false_type {};
+
+		template<typename A>
+		struct thread_safe_of<A, std::void_t<decltype(A::thread_safe)>>
+			: std::bool_constant<A::thread_safe> {};
+
+		template<typename A, typename = void>
+		struct singleton_of : std::false_type {};
+
+		template<typename A>
+		struct singleton_of<A, std::void_t<decltype(A::singleton)>>
+			: std::bool_constant<A::singleton> {};
+
+	} // detail
+
+	template<typename A>
+	constexpr inline bool is_allocator_adapter_v = detail::is_adapter<A>::value;
+
+	/// ---------------------------------------------------------------------
+	/// the optional parts of the adapter interface, with their defaults
+	template<typename A>
+	struct adapter_traits final {
+		static_assert(is_allocator_adapter_v<A>, "not an allocator adapter, see the top of allocator_registry.h");
+
+		constexpr static size_t max_size = detail::max_size_of<A>::value;
+		constexpr static size_t max_align = detail::max_align_of<A>::value;
+		constexpr static bool thread_safe = detail::thread_safe_of<A>::value;
+		constexpr static bool singleton = detail::singleton_of<A>::value;
+		constexpr static bool has_stats = detail::has_stats<A>::value;
+		/// can serve any size, not a fixed size pool
+		constexpr static bool general_purpose = max_size == SIZE_MAX;
+
+		static allocator_stats stats(A const& adapter_) noexcept {
+			if constexpr (has_stats)
+				return adapter_.stats();
+			else
+				return {};
+		}
+	};
+
+	/// ---------------------------------------------------------------------
+	/// stands for an adapter type, without making one
+	template<typename A>
+	struct adapter_tag final { using type = A; };
+
+	/// ---------------------------------------------------------------------
+	/// the registry is a type, there is nothing to construct
+	template<typename ... ADAPTERS>
+	struct allocator_registry final {
+
+		static_assert((is_allocator_adapter_v<ADAPTERS> && ...),
+			"not an allocator adapter, see the top of allocator_registry.h");
+		static_assert((std::is_default_constructible_v<ADAPTERS> && ...),
+			"registered adapters are made by the registry");
+
+		constexpr static size_t size = sizeof...(ADAPTERS);
+
+		/// call back is called with a fresh adapter instance, in the
+		/// order of registration, the adapter lives for the duration
+		/// of the call, thus each scenario starts with an empty pool
+		template<typename CB_>
+		static void for_each(CB_&& call_back_)
+		{
+			(for_one<ADAPTERS>(call_back_), ...);
+		}
+
+		/// call back is called with adapter_tag<A>, in the order of registration
+		/// for scenarios which need to do something before the adapter is made
+		template<typename CB_>
+		static void for_each_type(CB_&& call_back_)
+		{
+			(call_back_(adapter_tag<ADAPTERS>{}), ...);
+		}
+
+	private:
+		template<typename A, typename CB_>
+		static void for_one(CB_& call_back_)
+		{
+			A adapter_{};
+			call_back_(adapter_);
+		}
+	};
+
+	template<typename REGISTRY, typename CB_>
+	inline void for_each_allocator(CB_&& call_back_)
+	{
+		REGISTRY::for_each(std::forward<CB_>(call_back_));
+	}
+
+	/// ---------------------------------------------------------------------
+	/// makes an adapter which is not thread safe, safe, by one mutex
+	/// the adapter wrapped is not owned
+	template<typename A>
+	struct locked_adapter final {
+
+		explicit locked_adapter(A& wrapped_) noexcept : adapter_(wrapped_) {}
+
+		constexpr static size_t max_size = adapter_traits<A>::max_size;
+		constexpr static size_t max_align = adapter_traits<A>::max_align;
+		constexpr static bool thread_safe = true;
+
+		static const char* name() {
+			static const std::string name_ = std::string(A::name()) + " + mutex";
+			return name_.c_str();
+		}
+
+		void* allocate(size_t size_, size_t align_) {
+			std::lock_guard<std::mutex> guard_(mutex_);
+			return adapter_.allocate(size_, align_);
+		}
+
+		void deallocate(void* p_, size_t size_) {
+			std::lock_guard<std::mutex> guard_(mutex_);
+			adapter_.deallocate(p_, size_);
+		}
+
+		/// only if the adapter wrapped has them
+		template<typename B = A, std::enable_if_t<adapter_traits<B>::has_stats, int> = 0>
+		allocator_stats stats() const {
+			std::lock_guard<std::mutex> guard_(mutex_);
+			return adapter_.stats();
+		}
+
+	private:
+		mutable std::mutex mutex_{};
+		A& adapter_;
+	};
+
+	/// ---------------------------------------------------------------------
+	/// one adapter instance per thread, no locking
+	/// blocks must be freed on the thread which allocated them
+	/// the instances die with their threads
+	template<typename A>
+	struct per_thread_adapter final {
+
+		static_assert(!adapter_traits<A>::singleton, "instances of this adapter are not independent");
+
+		constexpr static size_t max_size = adapter_traits<A>::max_size;
+		constexpr static size_t max_align = adapter_traits<A>::max_align;
+		constexpr static bool thread_safe = true;
+
+		static const char* name() {
+			static const std::string name_ = std::string(A::name()) + " thread_local";
+			return name_.c_str();
+		}
+
+		void* allocate(size_t size_, size_t align_) {
+			return local().allocate(size_, align_);
+		}
+
+		void deallocate(void* p_, size_t size_) {
+			local().deallocate(p_, size_);
+		}
+
+	private:
+		static A& local() {
+			thread_local A adapter_{};
+			return adapter_;
+		}
+	};
+
+} // dbj::bench
+
+#endif // DBJ_ALLOCATOR_REGISTRY_INC
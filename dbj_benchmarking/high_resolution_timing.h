@@ -0,0 +1,184 @@
+#ifndef DBJ_HIGH_RESOLUTION_TIMING_INC
+#define DBJ_HIGH_RESOLUTION_TIMING_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ High resolution timing for the benchmarking drivers.
+
+ clock() is the process CPU time with (at best) millisecond granularity.
+ It can not resolve one pool allocate() which costs a few nanoseconds.
+
+ Two backends are provided
+  - std::chrono::steady_clock, the default one
+  - rdtsc / rdtscp cycle counter, calibrated against steady_clock
+	to be used define DBJ_TIMING_USE_TSC; x86 and x64 only
+
+ Both measure the cost of an empty start/stop pair once.
+ That cost is subtracted from every sample taken.
+*/
+
+#include <stdint.h>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DBJ_TIMING_HAS_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define DBJ_TIMING_HAS_TSC 0
+#endif
+
+// #define DBJ_TIMING_USE_TSC
+#if defined(DBJ_TIMING_USE_TSC) && (DBJ_TIMING_HAS_TSC == 0)
+#undef DBJ_TIMING_USE_TSC
+#endif
+
+namespace dbj::timing {
+
+	using tick_type = uint64_t;
+
+	/// ---------------------------------------------------------------------
+	struct steady_backend final {
+
+		constexpr static const char* name{ "steady_clock" };
+
+		static tick_type start() noexcept { return now(); }
+		static tick_type stop() noexcept { return now(); }
+
+		static double to_ns(tick_type ticks_) noexcept { return double(ticks_) * ns_per_tick; }
+
+	private:
+		using clock_type = std::chrono::steady_clock;
+
+		constexpr static double ns_per_tick{
+			1e9 * double(clock_type::period::num) / double(clock_type::period::den)
+		};
+
+		static tick_type now() noexcept {
+			return tick_type(clock_type::now().time_since_epoch().count());
+		}
+	};
+
+#if DBJ_TIMING_HAS_TSC
+	/// ---------------------------------------------------------------------
+	/// lfence before rdtsc stops it from being executed before the code
+	/// preceding it; rdtscp waits for the measured code to retire and
+	/// the lfence after it stops the following code to start too early
+	struct tsc_backend final {
+
+		constexpr static const char* name{ "rdtsc/rdtscp" };
+
+		static tick_type start() noexcept {
+			_mm_lfence();
+			return tick_type(__rdtsc());
+		}
+
+		static tick_type stop() noexcept {
+			unsigned int aux_{};
+			const tick_type rez_ = tick_type(__rdtscp(&aux_));
+			_mm_lfence();
+			return rez_;
+		}
+
+		static double to_ns(tick_type ticks_) noexcept { return double(ticks_) * ns_per_tick(); }
+
+		/// measured once against steady_clock
+		static double ns_per_tick() noexcept {
+			static const double ratio_ = [] {
+				using namespace std::chrono;
+				constexpr auto calibration_period_ = milliseconds(50);
+				const auto t0_ = steady_clock::now();
+				const tick_type c0_ = start();
+				while (steady_clock::now() - t0_ < calibration_period_) { /* spin */ }
+				const tick_type c1_ = stop();
+				const auto t1_ = steady_clock::now();
+				return double(duration_cast<nanoseconds>(t1_ - t0_).count()) / double(c1_ - c0_);
+			}();
+			return ratio_;
+		}
+	};
+#endif // DBJ_TIMING_HAS_TSC
+
+	/// ---------------------------------------------------------------------
+	template<typename BACKEND>
+	struct stopwatch final {
+
+		constexpr static const char* name{ BACKEND::name };
+
+		static tick_type start() noexcept { return BACKEND::start(); }
+		static tick_type stop() noexcept { return BACKEND::stop(); }
+
+		/// the cost of an empty start/stop pair, in ticks
+		/// the minimum of many attempts is the most stable estimate
+		static tick_type overhead_ticks() noexcept {
+			static const tick_type overhead_ = [] {
+				tick_type min_ = UINT64_MAX;
+				for (int j = 0; j < 0xFFFF; ++j) {
+					const tick_type s_ = BACKEND::start();
+					const tick_type e_ = BACKEND::stop();
+					if (e_ - s_ < min_) min_ = e_ - s_;
+				}
+				return min_;
+			}();
+			return overhead_;
+		}
+
+		static double overhead_ns() noexcept { return BACKEND::to_ns(overhead_ticks()); }
+
+		/// nanoseconds between start and stop, overhead subtracted
+		static double elapsed_ns(tick_type start_, tick_type stop_) noexcept {
+			const tick_type raw_ = stop_ - start_;
+			const tick_type overhead_ = overhead_ticks();
+			return BACKEND::to_ns(raw_ > overhead_ ? raw_ - overhead_ : 0);
+		}
+
+		/// nanoseconds spent inside the specimen()
+		template<typename F>
+		static double measure_ns(F&& specimen) {
+			const tick_type start_ = BACKEND::start();
+			specimen();
+			const tick_type stop_ = BACKEND::stop();
+			return elapsed_ns(start_, stop_);
+		}
+	};
+
+#ifdef DBJ_TIMING_USE_TSC
+	using engine = stopwatch<tsc_backend>;
+#else
+	using engine = stopwatch<steady_backend>;
+#endif // DBJ_TIMING_USE_TSC
+
+	/// ---------------------------------------------------------------------
+	/// stops the compiler from throwing away the value or the code
+	/// producing it, e.g. allocate/deallocate pairs in a tight loop
+	template<typename T>
+	inline void do_not_optimize(T const& value_) noexcept {
+#ifdef _MSC_VER
+		static const volatile void* volatile sink_{};
+		sink_ = &value_;
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r,m"(value_) : "memory");
+#endif
+	}
+
+	/// ---------------------------------------------------------------------
+	/// do the calibration and the overhead measurement
+	/// before the first sample, outside of any timed region
+	inline void warm_up() noexcept {
+		static auto _ = [] {
+#ifdef DBJ_TIMING_USE_TSC
+			tsc_backend::ns_per_tick();
+#endif
+			engine::overhead_ticks();
+			return true;
+		}();
+		(void)_;
+	}
+
+} // dbj::timing
+
+#endif // DBJ_HIGH_RESOLUTION_TIMING_INC
@@ -0,0 +1,174 @@
+#ifndef DBJ_LATENCY_HISTOGRAM_INC
+#define DBJ_LATENCY_HISTOGRAM_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ HDR histogram style, log bucketed latency distribution.
+
+ Every sample is recorded. Each power of two range of values is split
+ into the same number of linear sub buckets, thus the relative error
+ of any reported percentile is bounded, regardless of the magnitude.
+
+ Samples are given in nanoseconds and kept in picoseconds,
+ so batched per-operation averages below one nanosecond are not lost.
+ Count, min, max, mean and the variance are kept exact.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace dbj::latency {
+
+	/// ---------------------------------------------------------------------
+	/// all values in nanoseconds
+	struct summary final {
+		uint64_t count{};
+		double min{};
+		double max{};
+		double mean{};
+		double stddev{};
+		/// coefficient of variation, stddev / mean
+		double cv{};
+		double p50{};
+		double p90{};
+		double p99{};
+		double p999{};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// index of the most significant bit set, v must not be 0
+	inline int msb_index(uint64_t v) noexcept {
+#ifdef _MSC_VER
+		unsigned long idx_{};
+		_BitScanReverse64(&idx_, v);
+		return int(idx_);
+#else
+		return 63 - __builtin_clzll(v);
+#endif
+	}
+
+	/// ---------------------------------------------------------------------
+	class histogram final {
+
+		/// 2^6 linear sub buckets, ~3% max relative error
+		constexpr static int sub_bucket_bits{ 6 };
+		constexpr static uint64_t sub_bucket_count{ 1ULL << sub_bucket_bits };
+		constexpr static uint64_t sub_bucket_half{ sub_bucket_count / 2 };
+		/// first range is [0, sub_bucket_count) with exact buckets
+		/// each next range is one power of two, with sub_bucket_half buckets
+		constexpr static size_t bucket_count{
+			sub_bucket_count + (64 - sub_bucket_bits) * sub_bucket_half
+		};
+
+		std::vector<uint64_t> buckets_ = std::vector<uint64_t>(bucket_count, 0);
+		uint64_t count_{};
+		uint64_t min_{ UINT64_MAX };
+		uint64_t max_{};
+		/// Welford running mean and sum of squared differences
+		double mean_{};
+		double m2_{};
+
+		static size_t bucket_index(uint64_t v) noexcept {
+			if (v < sub_bucket_count) return size_t(v);
+			const int shift_ = msb_index(v) - sub_bucket_bits + 1;
+			return size_t(sub_bucket_count
+				+ (shift_ - 1) * sub_bucket_half
+				+ ((v >> shift_) - sub_bucket_half));
+		}
+
+		/// middle of the values range the bucket covers
+		static uint64_t bucket_value(size_t idx_) noexcept {
+			if (idx_ < sub_bucket_count) return idx_;
+			const uint64_t rest_ = idx_ - sub_bucket_count;
+			const int shift_ = int(rest_ / sub_bucket_half) + 1;
+			const uint64_t sub_ = rest_ % sub_bucket_half + sub_bucket_half;
+			return (sub_ << shift_) + ((1ULL << shift_) >> 1);
+		}
+
+	public:
+		constexpr static double picos_per_ns{ 1000.0 };
+
+		void record(double nanoseconds_) noexcept {
+			const uint64_t v_ = nanoseconds_ > 0 ? uint64_t(nanoseconds_ * picos_per_ns + 0.5) : 0;
+
+			buckets_[bucket_index(v_)] += 1;
+			count_ += 1;
+			if (v_ < min_) min_ = v_;
+			if (v_ > max_) max_ = v_;
+
+			const double delta_ = double(v_) - mean_;
+			mean_ += delta_ / double(count_);
+			m2_ += delta_ * (double(v_) - mean_);
+		}
+
+		uint64_t count() const noexcept { return count_; }
+
+		/// q in [0,1], result in nanoseconds
+		double percentile(double q) const noexcept {
+			if (count_ == 0) return 0;
+			uint64_t target_ = uint64_t(ceil(q * double(count_)));
+			if (target_ < 1) target_ = 1;
+
+			uint64_t running_{};
+			for (size_t j = 0; j < bucket_count; ++j) {
+				running_ += buckets_[j];
+				if (running_ >= target_) {
+					uint64_t v_ = bucket_value(j);
+					// the bucket middle may lay outside of what was seen
+					if (v_ < min_) v_ = min_;
+					if (v_ > max_) v_ = max_;
+					return double(v_) / picos_per_ns;
+				}
+			}
+			return double(max_) / picos_per_ns;
+		}
+
+		summary summarize() const noexcept {
+			summary rez_{};
+			if (count_ == 0) return rez_;
+			rez_.count = count_;
+			rez_.min = double(min_) / picos_per_ns;
+			rez_.max = double(max_) / picos_per_ns;
+			rez_.mean = mean_ / picos_per_ns;
+			rez_.stddev = (count_ > 1 ? sqrt(m2_ / double(count_ - 1)) : 0) / picos_per_ns;
+			rez_.cv = rez_.mean > 0 ? rez_.stddev / rez_.mean : 0;
+			rez_.p50 = percentile(0.50);
+			rez_.p90 = percentile(0.90);
+			rez_.p99 = percentile(0.99);
+			rez_.p999 = percentile(0.999);
+			return rez_;
+		}
+
+		void reset() noexcept {
+			for (auto& b_ : buckets_) b_ = 0;
+			count_ = 0; min_ = UINT64_MAX; max_ = 0;
+			mean_ = 0; m2_ = 0;
+		}
+	};
+
+	/// ---------------------------------------------------------------------
+	/// nanoseconds as text, in the most readable unit
+	struct ns_text final { char text[0x20]{}; };
+
+	inline ns_text to_text(double ns_) noexcept {
+		ns_text rez_{};
+		if (ns_ < 1e3)
+			snprintf(rez_.text, sizeof(rez_.text), "%8.2f ns", ns_);
+		else if (ns_ < 1e6)
+			snprintf(rez_.text, sizeof(rez_.text), "%8.2f us", ns_ / 1e3);
+		else if (ns_ < 1e9)
+			snprintf(rez_.text, sizeof(rez_.text), "%8.2f ms", ns_ / 1e6);
+		else
+			snprintf(rez_.text, sizeof(rez_.text), "%8.3f s ", ns_ / 1e9);
+		return rez_;
+	}
+
+} // dbj::latency
+
+#endif // DBJ_LATENCY_HISTOGRAM_INC
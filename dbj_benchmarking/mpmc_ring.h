@@ -0,0 +1,105 @@
+#ifndef DBJ_MPMC_RING_INC
+#define DBJ_MPMC_RING_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Bounded, lock free, multi producer multi consumer ring.
+ Dmitry Vyukov's design:
+ http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+
+ Each cell has a sequence number which tells if the cell is ready
+ to be written to, or to be read from, for the current lap of the ring.
+ Used to hand over memory blocks between threads in the benchmarks.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <memory>
+
+namespace dbj::bench {
+
+	template<typename T>
+	class mpmc_ring final {
+
+		struct cell final {
+			std::atomic<size_t> sequence_{};
+			T data_{};
+		};
+
+		constexpr static size_t cache_line_size{ 64 };
+
+		const size_t mask_{};
+		std::unique_ptr<cell[]> cells_{};
+
+		alignas(cache_line_size) std::atomic<size_t> enqueue_pos_{ 0 };
+		alignas(cache_line_size) std::atomic<size_t> dequeue_pos_{ 0 };
+
+	public:
+		/// capacity must be a power of two
+		explicit mpmc_ring(size_t capacity_)
+			: mask_(capacity_ - 1), cells_(new cell[capacity_])
+		{
+			assert(capacity_ >= 2 && (capacity_ & (capacity_ - 1)) == 0);
+			for (size_t j = 0; j < capacity_; ++j)
+				cells_[j].sequence_.store(j, std::memory_order_relaxed);
+		}
+
+		mpmc_ring(mpmc_ring const&) = delete;
+		mpmc_ring& operator = (mpmc_ring const&) = delete;
+		mpmc_ring(mpmc_ring&&) = delete;
+		mpmc_ring& operator = (mpmc_ring&&) = delete;
+
+		/// false if full
+		bool try_push(T const& value_) noexcept {
+			cell* cell_{};
+			size_t pos_ = enqueue_pos_.load(std::memory_order_relaxed);
+			for (;;) {
+				cell_ = &cells_[pos_ & mask_];
+				const size_t seq_ = cell_->sequence_.load(std::memory_order_acquire);
+				const intptr_t dif_ = intptr_t(seq_) - intptr_t(pos_);
+				if (dif_ == 0) {
+					if (enqueue_pos_.compare_exchange_weak(pos_, pos_ + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (dif_ < 0) {
+					return false;
+				}
+				else {
+					pos_ = enqueue_pos_.load(std::memory_order_relaxed);
+				}
+			}
+			cell_->data_ = value_;
+			cell_->sequence_.store(pos_ + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// false if empty
+		bool try_pop(T& value_) noexcept {
+			cell* cell_{};
+			size_t pos_ = dequeue_pos_.load(std::memory_order_relaxed);
+			for (;;) {
+				cell_ = &cells_[pos_ & mask_];
+				const size_t seq_ = cell_->sequence_.load(std::memory_order_acquire);
+				const intptr_t dif_ = intptr_t(seq_) - intptr_t(pos_ + 1);
+				if (dif_ == 0) {
+					if (dequeue_pos_.compare_exchange_weak(pos_, pos_ + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (dif_ < 0) {
+					return false;
+				}
+				else {
+					pos_ = dequeue_pos_.load(std::memory_order_relaxed);
+				}
+			}
+			value_ = cell_->data_;
+			cell_->sequence_.store(pos_ + mask_ + 1, std::memory_order_release);
+			return true;
+		}
+	};
+
+} // dbj::bench
+
+#endif // DBJ_MPMC_RING_INC
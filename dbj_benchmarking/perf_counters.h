@@ -0,0 +1,248 @@
+#ifndef DBJ_PERF_COUNTERS_INC
+#define DBJ_PERF_COUNTERS_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Hardware and kernel counters around the measured code.
+ Wall time tells how long, counters tell why.
+
+ Linux only, perf_event_open(2). Counted are cycles, instructions,
+ L1d and LLC read misses, dTLB read misses, page faults and context
+ switches, user space only, thus perf_event_paranoid up to 2 is fine.
+
+ Each counter which can not be opened, because of the kernel settings,
+ missing PMU (typical for VM's) or the platform, is marked as not
+ available and simply not reported. Nothing fails because of them.
+
+ All counters are opened once, in one group, and enabled and disabled
+ together around each measurement.
+
+ Define DBJ_NO_PERF_COUNTERS to switch all of this off.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__) && !defined(DBJ_NO_PERF_COUNTERS)
+#define DBJ_PERF_HAS_COUNTERS 1
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#else
+#define DBJ_PERF_HAS_COUNTERS 0
+#endif
+
+namespace dbj::perf {
+
+	enum class counter : unsigned {
+		cycles, instructions, l1d_misses, llc_misses, dtlb_misses, page_faults, context_switches
+	};
+
+	constexpr static unsigned counter_count = 7;
+
+	constexpr static const char* counter_names[counter_count]{
+		"cycles", "instructions", "L1d misses", "LLC misses", "dTLB misses", "page faults", "context switches"
+	};
+
+	/// names as used in the machine readable results
+	constexpr static const char* counter_keys[counter_count]{
+		"cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "page_faults", "context_switches"
+	};
+
+	/// one measurement
+	struct counter_values final {
+		uint64_t value[counter_count]{};
+		bool available[counter_count]{};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// summed over many measurements, reported per operation
+	struct counter_totals final {
+		double sum[counter_count]{};
+		bool available[counter_count]{};
+		uint64_t operations{};
+
+		void add(counter_values const& values_, uint64_t operations_) noexcept {
+			for (unsigned j = 0; j < counter_count; ++j) {
+				if (!values_.available[j]) continue;
+				sum[j] += double(values_.value[j]);
+				available[j] = true;
+			}
+			operations += operations_;
+		}
+
+		bool any() const noexcept {
+			for (bool a_ : available) if (a_) return true;
+			return false;
+		}
+
+		bool has(counter which_) const noexcept { return available[unsigned(which_)]; }
+
+		double per_op(counter which_) const noexcept {
+			return operations ? sum[unsigned(which_)] / double(operations) : 0.0;
+		}
+
+		void reset() noexcept { *this = counter_totals{}; }
+	};
+
+	/// ---------------------------------------------------------------------
+#if DBJ_PERF_HAS_COUNTERS
+	class counter_group final {
+
+		int fds_[counter_count]{ -1, -1, -1, -1, -1, -1, -1 };
+		/// position of each counter in the group read, -1 if not open
+		int slot_[counter_count]{ -1, -1, -1, -1, -1, -1, -1 };
+		int leader_{ -1 };
+		int opened_{ 0 };
+		const char* why_not_{ "" };
+
+		static int open_event(uint32_t type_, uint64_t config_, int group_fd_) noexcept
+		{
+			perf_event_attr attr_{};
+			attr_.size = sizeof(attr_);
+			attr_.type = type_;
+			attr_.config = config_;
+			attr_.disabled = group_fd_ == -1 ? 1 : 0;
+			attr_.exclude_kernel = 1;
+			attr_.exclude_hv = 1;
+			attr_.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			return int(::syscall(__NR_perf_event_open, &attr_, 0 /* this thread */, -1, group_fd_, 0));
+		}
+
+		static constexpr uint64_t cache_config(uint64_t cache_) noexcept {
+			return cache_ | (uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8) | (uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+		}
+
+		/// cache_events_ false leaves the three cache counters out
+		void open_all(bool cache_events_) noexcept
+		{
+			const struct { uint32_t type; uint64_t config; } events_[counter_count]{
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+				{ PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_L1D) },
+				{ PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_LL) },
+				{ PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_DTLB) },
+				{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+				{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+			};
+
+			for (unsigned j = 0; j < counter_count; ++j) {
+				if (!cache_events_ && events_[j].type == PERF_TYPE_HW_CACHE) continue;
+				const int fd_ = open_event(events_[j].type, events_[j].config, leader_);
+				if (fd_ < 0) {
+					if (!*why_not_) why_not_ = strerror(errno);
+					continue;
+				}
+				if (leader_ < 0) leader_ = fd_;
+				fds_[j] = fd_;
+				slot_[j] = opened_++;
+			}
+		}
+
+		void close_all() noexcept
+		{
+			for (unsigned j = 0; j < counter_count; ++j) {
+				if (fds_[j] >= 0) ::close(fds_[j]);
+				fds_[j] = slot_[j] = -1;
+			}
+			leader_ = -1;
+			opened_ = 0;
+		}
+
+	public:
+		/// the PMU may accept each counter and still be unable to schedule
+		/// them all together, then the group never counts; the cache
+		/// counters are the ones to go
+		counter_group() noexcept
+		{
+			open_all(true);
+			start();
+			const counter_values trial_ = stop();
+			if (valid() && !trial_.available[unsigned(counter::cycles)] && !trial_.available[unsigned(counter::page_faults)]) {
+				close_all();
+				open_all(false);
+				why_not_ = "cache counters can not be scheduled together with the others";
+			}
+		}
+
+		~counter_group() { close_all(); }
+
+		counter_group(counter_group const&) = delete;
+		counter_group& operator = (counter_group const&) = delete;
+
+		bool valid() const noexcept { return leader_ >= 0; }
+
+		/// less than all the counters are open
+		bool partial() const noexcept { return opened_ < int(counter_count); }
+
+		/// why the first counter which is not open, is not
+		const char* why_not() const noexcept {
+			return why_not_;
+		}
+
+		void start() noexcept {
+			if (!valid()) return;
+			::ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			::ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+
+		/// if the group was multiplexed, values are scaled to the time enabled
+		/// if it was never scheduled, nothing is available
+		counter_values stop() noexcept {
+			counter_values rez_{};
+			if (!valid()) return rez_;
+			::ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+			// nr, time_enabled, time_running, values
+			uint64_t buf_[3 + counter_count]{};
+			if (::read(leader_, buf_, sizeof(buf_)) < ssize_t(3 * sizeof(uint64_t)))
+				return rez_;
+
+			const uint64_t enabled_ = buf_[1], running_ = buf_[2];
+			if (running_ == 0) return rez_;
+			const double scale_ = double(enabled_) / double(running_);
+
+			for (unsigned j = 0; j < counter_count; ++j) {
+				if (slot_[j] < 0 || uint64_t(slot_[j]) >= buf_[0]) continue;
+				rez_.value[j] = uint64_t(double(buf_[3 + slot_[j]]) * scale_);
+				rez_.available[j] = true;
+			}
+			return rez_;
+		}
+	};
+#else
+	/// nothing is ever available
+	class counter_group final {
+	public:
+		bool valid() const noexcept { return false; }
+		bool partial() const noexcept { return true; }
+		const char* why_not() const noexcept { return "not supported on this platform"; }
+		void start() noexcept {}
+		counter_values stop() noexcept { return {}; }
+	};
+#endif // DBJ_PERF_HAS_COUNTERS
+
+	/// ---------------------------------------------------------------------
+	/// the counters count the calling thread only
+	/// all the measurements in here are done on the main thread
+	inline counter_group& counters()
+	{
+		static counter_group group_{};
+		static const bool reported_ = [] {
+			if (!group_.valid())
+				fprintf(stderr, "\nHardware counters are not available: %s\n", group_.why_not());
+			else if (group_.partial())
+				fprintf(stderr, "\nSome hardware counters are not available: %s\n", group_.why_not());
+			return true;
+		}();
+		(void)reported_;
+		return group_;
+	}
+
+} // dbj::perf
+
+#endif // DBJ_PERF_COUNTERS_INC
@@ -0,0 +1,72 @@
+#ifndef DBJ_PROCESS_MEMORY_INC
+#define DBJ_PROCESS_MEMORY_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ How much of the process is resident in physical memory, right now.
+ Linux: /proc/self/statm, Windows: working set size.
+
+ And a way to give the free system heap memory back.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
+#elif defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+namespace dbj::process_memory {
+
+	/// 0 if not available on this platform
+	inline size_t current_rss() noexcept
+	{
+#if defined(__linux__)
+		// kept open, reading it is then a single system call
+		static const int statm_fd_ = ::open("/proc/self/statm", O_RDONLY);
+		static const long page_size_ = ::sysconf(_SC_PAGESIZE);
+		if (statm_fd_ < 0) return 0;
+
+		char buf_[0x80]{};
+		const ssize_t len_ = ::pread(statm_fd_, buf_, sizeof(buf_) - 1, 0);
+		if (len_ <= 0) return 0;
+		// "size resident shared text lib data dt", in pages
+		char* next_{};
+		(void)strtoull(buf_, &next_, 10);
+		const unsigned long long resident_ = strtoull(next_, nullptr, 10);
+		return size_t(resident_) * size_t(page_size_);
+#elif defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters_{};
+		if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &counters_, sizeof(counters_)))
+			return 0;
+		return counters_.WorkingSetSize;
+#else
+		return 0;
+#endif
+	}
+
+	/// ---------------------------------------------------------------------
+	/// give the free memory of the system heap back to the OS, if possible
+	/// called in between specimens, so that one does not
+	/// inherit the resident memory left behind by the previous one
+	inline void trim_system_heap() noexcept
+	{
+#if defined(__linux__) && defined(__GLIBC__)
+		::malloc_trim(0);
+#elif defined(_WIN32)
+		::HeapCompact(::GetProcessHeap(), 0);
+#endif
+	}
+
+} // dbj::process_memory
+
+#endif // DBJ_PROCESS_MEMORY_INC
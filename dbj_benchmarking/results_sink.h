@@ -0,0 +1,384 @@
+#ifndef DBJ_RESULTS_SINK_INC
+#define DBJ_RESULTS_SINK_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Machine readable results, next to the coloured console text.
+
+ Scenario reporters add one record per allocator measured.
+ At the end of the run all the records are written as JSON and as CSV.
+ Each record carries the run metadata: CPU model, compiler, compiler
+ flags, git hash, timing backend and the time of the run.
+
+ Output paths are taken from the DBJ_RESULTS_JSON and DBJ_RESULTS_CSV
+ environment variables, if not set: dbj_results.json and dbj_results.csv
+
+ Build may define DBJ_GIT_HASH and DBJ_COMPILER_FLAGS as string literals
+ if not, git is asked at run time and the flags are deduced from the
+ predefined macros
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "high_resolution_timing.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#define DBJ_RESULTS_HAS_CPUID 1
+#else
+#define DBJ_RESULTS_HAS_CPUID 0
+#endif
+
+namespace dbj::results {
+
+	/// a named value which is not a latency, e.g. Mops/sec
+	struct metric final {
+		std::string name{};
+		double value{};
+	};
+
+	struct record final {
+		std::string scenario{};
+		std::string allocator{};
+		/// bytes per allocation, 0 for mixed sizes
+		size_t object_size{};
+		unsigned threads{ 1 };
+		/// nanoseconds, count is 0 if the scenario has no latency samples
+		latency::summary latency{};
+		std::vector<metric> metrics{};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// run metadata
+	/// ---------------------------------------------------------------------
+	inline std::string cpu_model()
+	{
+#if DBJ_RESULTS_HAS_CPUID
+		unsigned int regs_[12]{};
+#ifdef _MSC_VER
+		int info_[4]{};
+		__cpuid(info_, 0x80000000);
+		if (unsigned(info_[0]) < 0x80000004) return "unknown";
+		for (int j = 0; j < 3; ++j) {
+			__cpuid(info_, 0x80000002 + j);
+			memcpy(regs_ + 4 * j, info_, sizeof(info_));
+		}
+#else
+		if (__get_cpuid_max(0x80000000, nullptr) < 0x80000004) return "unknown";
+		for (unsigned j = 0; j < 3; ++j)
+			__get_cpuid(0x80000002 + j, regs_ + 4 * j, regs_ + 4 * j + 1, regs_ + 4 * j + 2, regs_ + 4 * j + 3);
+#endif
+		char brand_[sizeof(regs_) + 1]{};
+		memcpy(brand_, regs_, sizeof(regs_));
+		// brand string is padded with spaces on the left
+		const char* text_ = brand_;
+		while (*text_ == ' ') ++text_;
+		return text_;
+#else
+		return "unknown";
+#endif
+	}
+
+	inline std::string compiler()
+	{
+#if defined(__clang__)
+		return "clang " __clang_version__;
+#elif defined(__GNUC__)
+		return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+		return "unknown";
+#endif
+	}
+
+	/// as far as the predefined macros can tell
+	inline std::string compiler_flags()
+	{
+#ifdef DBJ_COMPILER_FLAGS
+		return DBJ_COMPILER_FLAGS;
+#else
+		std::string flags_{};
+		auto add_ = [&](const char* flag_) {
+			if (!flags_.empty()) flags_ += ' ';
+			flags_ += flag_;
+		};
+#ifdef NDEBUG
+		add_("NDEBUG");
+#endif
+#ifdef _DEBUG
+		add_("_DEBUG");
+#endif
+#ifdef __OPTIMIZE__
+		add_("__OPTIMIZE__");
+#endif
+#ifdef __AVX2__
+		add_("__AVX2__");
+#elif defined(__AVX__)
+		add_("__AVX__");
+#endif
+#if defined(_M_X64) || defined(__x86_64__)
+		add_("x64");
+#elif defined(_M_IX86) || defined(__i386__)
+		add_("x86");
+#elif defined(_M_ARM64) || defined(__aarch64__)
+		add_("arm64");
+#endif
+#ifdef DBJ_TIMING_USE_TSC
+		add_("DBJ_TIMING_USE_TSC");
+#endif
+#ifdef _MSVC_LANG
+		add_(("_MSVC_LANG=" + std::to_string(_MSVC_LANG)).c_str());
+#else
+		add_(("__cplusplus=" + std::to_string(__cplusplus)).c_str());
+#endif
+		return flags_;
+#endif // DBJ_COMPILER_FLAGS
+	}
+
+	inline std::string git_hash()
+	{
+#ifdef DBJ_GIT_HASH
+		return DBJ_GIT_HASH;
+#else
+#ifdef _WIN32
+		FILE* git_ = ::_popen("git rev-parse --short HEAD 2>nul", "r");
+#else
+		FILE* git_ = ::popen("git rev-parse --short HEAD 2>/dev/null", "r");
+#endif
+		if (!git_) return "unknown";
+		char hash_[0x40]{};
+		const bool read_ = nullptr != fgets(hash_, sizeof(hash_), git_);
+#ifdef _WIN32
+		::_pclose(git_);
+#else
+		::pclose(git_);
+#endif
+		if (!read_) return "unknown";
+		hash_[strcspn(hash_, "\r\n")] = '\0';
+		return hash_[0] ? hash_ : "unknown";
+#endif // DBJ_GIT_HASH
+	}
+
+	/// UTC, ISO 8601
+	inline std::string timestamp()
+	{
+		const time_t now_ = time(nullptr);
+		char text_[0x20]{};
+		strftime(text_, sizeof(text_), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now_));
+		return text_;
+	}
+
+	struct run_metadata final {
+		std::string cpu_model{}, compiler{}, compiler_flags{}, git_hash{}, timing{}, timestamp{};
+	};
+
+	/// taken once, main() does it before the first measurement
+	/// asking git is not something to be done in between them
+	inline run_metadata const& metadata()
+	{
+		static const run_metadata meta_{
+			cpu_model(), compiler(), compiler_flags(), git_hash(), timing::engine::name, timestamp()
+		};
+		return meta_;
+	}
+
+	/// ---------------------------------------------------------------------
+	/// text escaping and number formatting
+	/// ---------------------------------------------------------------------
+	namespace detail {
+
+		inline std::string json_string(std::string const& text_)
+		{
+			std::string out_{ '"' };
+			for (const char c_ : text_) {
+				switch (c_) {
+				case '"': out_ += "\\\""; break;
+				case '\\': out_ += "\\\\"; break;
+				case '\n': out_ += "\\n"; break;
+				case '\t': out_ += "\\t"; break;
+				default:
+					if ((unsigned char)c_ < 0x20) {
+						char esc_[8]{};
+						snprintf(esc_, sizeof(esc_), "\\u%04x", unsigned(c_));
+						out_ += esc_;
+					}
+					else out_ += c_;
+				}
+			}
+			return out_ += '"';
+		}
+
+		inline std::string csv_field(std::string const& text_)
+		{
+			if (text_.find_first_of(",\"\r\n") == std::string::npos) return text_;
+			std::string out_{ '"' };
+			for (const char c_ : text_) {
+				if (c_ == '"') out_ += '"';
+				out_ += c_;
+			}
+			return out_ += '"';
+		}
+
+		/// JSON has no NaN or infinity
+		inline std::string number(double value_, bool json_)
+		{
+			if (!isfinite(value_)) return json_ ? "null" : "";
+			char text_[0x40]{};
+			// counts and byte sizes are whole numbers
+			if (value_ == floor(value_) && fabs(value_) < 1e15)
+				snprintf(text_, sizeof(text_), "%.0f", value_);
+			else
+				snprintf(text_, sizeof(text_), "%.3f", value_);
+			return text_;
+		}
+
+		/// name, value pairs of the latency summary, in the output order
+		template<typename CB_>
+		inline void for_each_latency_field(latency::summary const& sum_, CB_ call_back_)
+		{
+			call_back_("count", double(sum_.count));
+			call_back_("min_ns", sum_.min);
+			call_back_("mean_ns", sum_.mean);
+			call_back_("stddev_ns", sum_.stddev);
+			call_back_("cv", sum_.cv);
+			call_back_("p50_ns", sum_.p50);
+			call_back_("p90_ns", sum_.p90);
+			call_back_("p99_ns", sum_.p99);
+			call_back_("p999_ns", sum_.p999);
+			call_back_("max_ns", sum_.max);
+		}
+	} // detail
+
+	/// ---------------------------------------------------------------------
+	class results_sink final {
+		std::vector<record> records_{};
+	public:
+		void add(record new_record_) {
+			records_.push_back(std::move(new_record_));
+		}
+
+		size_t size() const noexcept { return records_.size(); }
+
+		/// false if the file could not be written
+		bool write_json(const char* path_) const
+		{
+			using detail::json_string;
+			using detail::number;
+
+			FILE* file_ = fopen(path_, "w");
+			if (!file_) return false;
+
+			run_metadata const& meta_ = metadata();
+
+			fprintf(file_, "[\n");
+			for (size_t j = 0; j < records_.size(); ++j) {
+				record const& rec_ = records_[j];
+				fprintf(file_, "  {\n");
+				fprintf(file_, "    \"scenario\": %s,\n", json_string(rec_.scenario).c_str());
+				fprintf(file_, "    \"allocator\": %s,\n", json_string(rec_.allocator).c_str());
+				fprintf(file_, "    \"object_size\": %zu,\n", rec_.object_size);
+				fprintf(file_, "    \"threads\": %u,\n", rec_.threads);
+
+				detail::for_each_latency_field(rec_.latency, [&](const char* name_, double value_) {
+					fprintf(file_, "    \"%s\": %s,\n", name_, number(value_, true).c_str());
+				});
+
+				fprintf(file_, "    \"metrics\": {");
+				for (size_t k = 0; k < rec_.metrics.size(); ++k)
+					fprintf(file_, "%s %s: %s", k ? "," : "",
+						json_string(rec_.metrics[k].name).c_str(), number(rec_.metrics[k].value, true).c_str());
+				fprintf(file_, " },\n");
+
+				fprintf(file_, "    \"cpu_model\": %s,\n", json_string(meta_.cpu_model).c_str());
+				fprintf(file_, "    \"compiler\": %s,\n", json_string(meta_.compiler).c_str());
+				fprintf(file_, "    \"compiler_flags\": %s,\n", json_string(meta_.compiler_flags).c_str());
+				fprintf(file_, "    \"git_hash\": %s,\n", json_string(meta_.git_hash).c_str());
+				fprintf(file_, "    \"timing\": %s,\n", json_string(meta_.timing).c_str());
+				fprintf(file_, "    \"timestamp\": %s\n", json_string(meta_.timestamp).c_str());
+				fprintf(file_, "  }%s\n", j + 1 < records_.size() ? "," : "");
+			}
+			fprintf(file_, "]\n");
+
+			return 0 == fclose(file_);
+		}
+
+		/// metrics are in one column, as name=value;name=value
+		bool write_csv(const char* path_) const
+		{
+			using detail::csv_field;
+			using detail::number;
+
+			FILE* file_ = fopen(path_, "w");
+			if (!file_) return false;
+
+			run_metadata const& meta_ = metadata();
+
+			fprintf(file_, "scenario,allocator,object_size,threads");
+			detail::for_each_latency_field(latency::summary{}, [&](const char* name_, double) {
+				fprintf(file_, ",%s", name_);
+			});
+			fprintf(file_, ",metrics,cpu_model,compiler,compiler_flags,git_hash,timing,timestamp\n");
+
+			for (record const& rec_ : records_) {
+				fprintf(file_, "%s,%s,%zu,%u", csv_field(rec_.scenario).c_str(),
+					csv_field(rec_.allocator).c_str(), rec_.object_size, rec_.threads);
+
+				detail::for_each_latency_field(rec_.latency, [&](const char*, double value_) {
+					fprintf(file_, ",%s", number(value_, false).c_str());
+				});
+
+				std::string metrics_{};
+				for (metric const& m_ : rec_.metrics) {
+					if (!metrics_.empty()) metrics_ += ';';
+					metrics_ += m_.name + '=' + number(m_.value, false);
+				}
+
+				fprintf(file_, ",%s,%s,%s,%s,%s,%s,%s\n", csv_field(metrics_).c_str(),
+					csv_field(meta_.cpu_model).c_str(), csv_field(meta_.compiler).c_str(),
+					csv_field(meta_.compiler_flags).c_str(), csv_field(meta_.git_hash).c_str(),
+					csv_field(meta_.timing).c_str(), csv_field(meta_.timestamp).c_str());
+			}
+
+			return 0 == fclose(file_);
+		}
+	};
+
+	/// the one for the whole run
+	inline results_sink& sink()
+	{
+		static results_sink sink_{};
+		return sink_;
+	}
+
+	/// ---------------------------------------------------------------------
+	/// called once, after all the scenarios have been run
+	inline void write_results()
+	{
+		const char* json_path_ = getenv("DBJ_RESULTS_JSON");
+		const char* csv_path_ = getenv("DBJ_RESULTS_CSV");
+		if (!json_path_) json_path_ = "dbj_results.json";
+		if (!csv_path_) csv_path_ = "dbj_results.csv";
+
+		if (sink().size() < 1) return;
+
+		if (!sink().write_json(json_path_))
+			fprintf(stderr, "\nCould not write the results to: %s\n", json_path_);
+		if (!sink().write_csv(csv_path_))
+			fprintf(stderr, "\nCould not write the results to: %s\n", csv_path_);
+	}
+
+} // dbj::results
+
+#endif // DBJ_RESULTS_SINK_INC
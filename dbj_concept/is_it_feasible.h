@@ -3,6 +3,12 @@
 #include "../common.h"
 #include "../dbj--nanolib/dbj_heap_alloc.h"
 #include "../dbj_pool_allocator/dbj_shoshnikov_pool_allocator.h"
+#include "../dbj_pool_allocator/dbj_concurrent_pool_allocator.h"
+#include "../dbj_pool_allocator/dbj_static_pool.h"
+
+#include <algorithm>
+#include <new>
+#include <type_traits>
 
 namespace feasibility {
 
@@ -17,11 +23,18 @@ namespace feasibility {
 		}
 	};
 
+	/// DBJ added
+	/// over-aligned, each object on its own cache line
+	struct alignas(64) AlignedData : Data {};
+
 	using dbj::shohnikov::dbj_pool_allocator;
 	using dbj::shohnikov::legal_block_size;
+	using dbj::shohnikov::static_pool;
 
 #define test_data_size 0xFFFF 
 #define loop_each 0xF
+/// arrays of that many fit in one block of the pool
+#define array_length 0xFF
 
 	/// this is very favourable manual setup
 	/// tuned so that two blocks only are allocated per session
@@ -46,8 +59,26 @@ namespace feasibility {
 			// same size == sizeof(Pooled)
 			// internaly it heap allocates alokator_block_size
 			// chunks in one go, keeping them together in block's
-			static ALLOCATOR_TYPE alokator(alokator_block_size, sizeof(Pooled));
-			return alokator;
+			if constexpr (std::is_default_constructible_v<ALLOCATOR_TYPE>) {
+				// DBJ: the geometry is in the type, see dbj_static_pool.h
+				static_assert(sizeof(Pooled) <= ALLOCATOR_TYPE::chunk_size);
+				static_assert(alignof(Pooled) <= ALLOCATOR_TYPE::chunk_alignment);
+				static ALLOCATOR_TYPE alokator{};
+				return alokator;
+			}
+			else if constexpr (std::is_constructible_v<ALLOCATOR_TYPE,
+				legal_block_size, size_t, dbj::shohnikov::chunk_alignment>) {
+				// DBJ: chunks are aligned as Pooled is
+				static ALLOCATOR_TYPE alokator(alokator_block_size, sizeof(Pooled),
+					dbj::shohnikov::chunk_alignment{ (std::max)(alignof(Pooled), sizeof(void*)) });
+				return alokator;
+			}
+			else {
+				// DBJ: chunks are word aligned only
+				static_assert(alignof(Pooled) <= sizeof(void*));
+				static ALLOCATOR_TYPE alokator(alokator_block_size, sizeof(Pooled));
+				return alokator;
+			}
 		}
 
 		static void* operator new(size_t size) {
@@ -62,18 +93,39 @@ namespace feasibility {
 			return allocator().deallocate(ptr);
 		}
 
-		/// fixed size pool allocator can not do this
+		/// DBJ added
+		/// new calls these for the over-aligned DATA_TYPE
+		/// the pool chunks are aligned as Pooled is, see allocator()
+		static void* operator new(size_t size, std::align_val_t alignment) {
+			void* chunk_ = allocator().allocate();
+			_ASSERTE(((uintptr_t)chunk_ & (size_t(alignment) - 1)) == 0);
+			return chunk_;
+		}
+
+		static void operator delete(void* ptr, size_t size, std::align_val_t) {
+			return allocator().deallocate(ptr);
+		}
+
 		/// size provided  to new [] is the total size of the array
+		/// DBJ: the pool array mode serves it, from a run of chunks
+		/// arrays larger than a block are served by the system
 		static void* operator new [](size_t size) {
-			// there is no size argument 
-			// this is fixed size allocator
-			// this is unusable --> return allocator().allocate();
-			return malloc(size);
+			return allocator().array_allocate(size);
 		}
 
-			static void operator delete [](void* ptr) {
-			 // can not use this --> return allocator().deallocate(ptr);
-			free(ptr);
+		static void operator delete [](void* ptr) {
+			allocator().array_deallocate(ptr);
+		}
+
+		/// DBJ added
+		static void* operator new [](size_t size, std::align_val_t alignment) {
+			void* array_ = allocator().array_allocate(size);
+			_ASSERTE(((uintptr_t)array_ & (size_t(alignment) - 1)) == 0);
+			return array_;
+		}
+
+		static void operator delete [](void* ptr, std::align_val_t) {
+			allocator().array_deallocate(ptr);
 		}
 
 	}; // Pooled
@@ -126,37 +178,77 @@ namespace feasibility {
 				DBJ_REPEAT(test_data_size) {
 					delete test_data[dbj_repeat_counter_];
 				}
-			}
+			}, test_data_size
 		);
 	}
 	
+	/// ----------------------------------------------------------------------------------
+	/// same as above but all the chunks are taken and given back in one call
+	/// objects are made in place, the pool is the one Pooled operator new uses
+	template< typename OBJTYPE>
+	inline auto bulk_meta_driver( dbj::collector & collector_ ) {
+
+		dbj::driver(collector_,
+			[&] {
+				OBJTYPE* test_data[test_data_size]{ 0 };
+				const size_t made_ = OBJTYPE::allocator().allocate_n(test_data_size, (void**)test_data);
+				_ASSERTE(made_ == test_data_size); (void)made_;
+				// make and use them one by one
+				DBJ_REPEAT(test_data_size) {
+					::new (test_data[dbj_repeat_counter_]) OBJTYPE;
+					test_data[dbj_repeat_counter_]->data.populate();
+				}
+				// remove them all at once
+				DBJ_REPEAT(test_data_size) {
+					test_data[dbj_repeat_counter_]->~OBJTYPE();
+				}
+				OBJTYPE::allocator().deallocate_n((void**)test_data, test_data_size);
+			}, test_data_size
+		);
+	}
+
 	/// ----------------------------------------------------------------------------------
 	/// if I need to make OBJTYPE * obj_ptr_array[test_data_size]
 	/// why would I do them one by one in a loop? 
-	/// why not all at once
-	/// OBJTYPE* test_data = new OBJTYPE[test_data_size];
+	/// why not in arrays
+	/// OBJTYPE* test_data = new OBJTYPE[array_length];
+	/// the same number of objects as above, in arrays which the pool can serve
 	template< typename OBJTYPE>
 	inline auto array_meta_driver( dbj::collector & collector_ ) {
 
+		constexpr size_t array_count = test_data_size / array_length;
+
 		dbj::driver(collector_,
 			[&] {
+				OBJTYPE* test_data[array_count]{ 0 };
 				// make them 
-				OBJTYPE* test_data = new OBJTYPE[test_data_size];
+				DBJ_REPEAT(array_count) {
+					test_data[dbj_repeat_counter_] = new OBJTYPE[array_length];
+				}
 				// use them 
-				DBJ_REPEAT(test_data_size) {
-					test_data[dbj_repeat_counter_].data.populate();
+				DBJ_REPEAT(array_count) {
+					OBJTYPE* array_ = test_data[dbj_repeat_counter_];
+					for (size_t j = 0; j < array_length; ++j)
+						array_[j].data.populate();
 				}
 				// remove them
-				delete [] test_data;
-			}
+				DBJ_REPEAT(array_count) {
+					delete [] test_data[dbj_repeat_counter_];
+				}
+			}, array_count * array_length
 		);
 	}
 	/// ----------------------------------------------------------------------------------
-	static inline void reporter (const char* name, float min, float max, int count) {
-		DBJ_PRINT( DBJ_FG_RED_BOLD "%s " DBJ_RESET "has been tested %3d times, test data size was: %d", 
-			name, count, test_data_size);
-		DBJ_PRINT("Rezults are -- min time: %0.3f sec, max time: %0.3f sec, avg mean time: " DBJ_FG_RED_BOLD " %0.3f sec" DBJ_RESET,
-			min, max, (min + max) / 2);
+	/// counters are per one object made, used and removed
+	static inline void reporter (const char* name, dbj::latency::summary const& sum_, dbj::perf::counter_totals const& counters_) {
+		DBJ_PRINT( DBJ_FG_RED_BOLD "%s " DBJ_RESET "has been tested %3d times, test data size was: %d",
+			name, int(sum_.count), test_data_size);
+		dbj::print_summary(sum_);
+		dbj::print_counters(counters_);
+
+		dbj::results::record record_{ "feasibility", name, sizeof(Data), 1, sum_, dbj::counter_metrics(counters_) };
+		record_.metrics.push_back({ "objects", double(test_data_size) });
+		dbj::results::sink().add(std::move(record_));
 	}
 	/// ----------------------------------------------------------------------------------
 	static inline void compare_individual_pool_and_system() {
@@ -164,6 +256,11 @@ namespace feasibility {
 		const auto test_loop_size = 0xF;
 
 		dbj::collector coll_pooled("Pooled");
+		/// the one above is a data race as soon as two threads call new
+		dbj::collector coll_pooled_mt("Pooled, thread safe");
+		dbj::collector coll_pooled_bulk("Pooled, allocate_n");
+		dbj::collector coll_pooled_static("Pooled, static_pool");
+		dbj::collector coll_pooled_aligned("Pooled, alignas(64)");
 		dbj::collector coll_not_pooled("NOT Pooled");
 
 		DBJ_PRINT( DBJ_FG_BLUE_BOLD "Comparing indiviaul allocation using new/delete"  DBJ_RESET);
@@ -172,12 +269,24 @@ namespace feasibility {
 		{
 			printf(" . ");
 			meta_driver< Pooled<dbj::shohnikov::dbj_pool_allocator, Data> >(coll_pooled);
+			meta_driver< Pooled<dbj::shohnikov::dbj_concurrent_pool_allocator, Data> >(coll_pooled_mt);
+			bulk_meta_driver< Pooled<dbj::shohnikov::dbj_pool_allocator, Data> >(coll_pooled_bulk);
+			meta_driver< Pooled<static_pool<Data, size_t(alokator_block_size)>, Data> >(coll_pooled_static);
+			meta_driver< Pooled<dbj::shohnikov::dbj_pool_allocator, AlignedData> >(coll_pooled_aligned);
 			meta_driver<NOTPooled>(coll_not_pooled);
 		}
 
 		DBJ_PRINT(" ");
 		dbj::collector::report(	coll_pooled, reporter );
 		DBJ_PRINT(" ");
+		dbj::collector::report(	coll_pooled_mt, reporter );
+		DBJ_PRINT(" ");
+		dbj::collector::report(	coll_pooled_bulk, reporter );
+		DBJ_PRINT(" ");
+		dbj::collector::report(	coll_pooled_static, reporter );
+		DBJ_PRINT(" ");
+		dbj::collector::report(	coll_pooled_aligned, reporter );
+		DBJ_PRINT(" ");
 		dbj::collector::report(coll_not_pooled, reporter );
 		DBJ_PRINT(" ");
 	}
@@ -190,8 +299,7 @@ namespace feasibility {
 		dbj::collector coll_pooled("Pooled Array");
 		dbj::collector coll_not_pooled("NOT Pooled Array");
 
-		DBJ_PRINT( DBJ_FG_BLUE_BOLD "Comparing array allocation using new[]/delete[]"  DBJ_RESET);
-		DBJ_PRINT( DBJ_FG_BLUE_BOLD "Fixed pool actually can not be used inside class new[]/delete[], so this comparison has no meaning..."  DBJ_RESET);
+		DBJ_PRINT( DBJ_FG_BLUE_BOLD "Comparing array allocation using new[]/delete[], arrays of %d"  DBJ_RESET, array_length);
 
 		DBJ_PRINT("Please wait, test loop count is: %d ", test_loop_size);
 		DBJ_REPEAT(test_loop_size)
@@ -221,5 +329,6 @@ namespace feasibility {
 
 #undef test_data_size
 #undef loop_each
+#undef array_length
 
 } // feasibility
\ No newline at end of file
@@ -0,0 +1,191 @@
+#ifndef DBJ_BLOCK_SOURCE_INC
+#define DBJ_BLOCK_SOURCE_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Where the pool blocks come from.
+
+ heap: DBJ_NANO_MALLOC / DBJ_NANO_FREE, the default. Blocks compete with
+ everything else on the general heap.
+
+ mapped: straight from the OS, anonymous mmap on Linux, VirtualAlloc on
+ Windows. Blocks are page aligned, given back whole on release.
+
+ huge: mapped, 2 MiB aligned and sized, with MADV_HUGEPAGE, thus the
+ transparent huge pages can back them, one TLB entry per 2 MiB.
+ Linux only, elsewhere the same as mapped. Meant for the blocks of
+ 2 MiB or more, smaller are rounded up to 2 MiB.
+
+ populate: mapped blocks are faulted in when taken, no page faults later
+ but all the pages are resident from the start, the lazy carving of the
+ pool does not help with that.
+
+ decommit() gives the pages back and keeps the address range, their
+ contents are lost, MADV_DONTNEED, on Windows MEM_RESET. The pages stay
+ committed on Windows, there is no recommit which could fail. Only the
+ whole pages of the range are given back. Nothing for the heap blocks.
+
+ alignment: of the block start, up to the page size. Mapped blocks are
+ page aligned anyway, heap blocks aligned beyond max_align_t are taken
+ larger, the pointer the heap gave is kept just before the block.
+
+ Elsewhere, mapped is the same as heap.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#define DBJ_BLOCK_SOURCE_HAS_MAPPING 1
+#elif defined(_WIN32)
+// windows.h is in by now, dbj nanolib heap allocation is HeapAlloc
+#define DBJ_BLOCK_SOURCE_HAS_MAPPING 1
+#else
+#define DBJ_BLOCK_SOURCE_HAS_MAPPING 0
+#endif
+
+namespace dbj::shohnikov {
+
+	/// heap blocks aligned beyond what the heap gives
+	namespace heap_aligned {
+
+		constexpr static size_t heap_alignment{ alignof(max_align_t) };
+
+		/// alignment_ is a power of two, null on failure
+		inline char* take(size_t size_, size_t alignment_) noexcept {
+			if (alignment_ <= heap_alignment) return DBJ_NANO_MALLOC(char, size_);
+			char* const raw_ = DBJ_NANO_MALLOC(char, size_ + alignment_);
+			if (raw_ == nullptr) return nullptr;
+			// at least heap_alignment after raw_, room for the pointer
+			char* const block_ = (char*)(((uintptr_t)raw_ + alignment_) & ~(uintptr_t)(alignment_ - 1));
+			((char**)block_)[-1] = raw_;
+			return block_;
+		}
+
+		/// alignment_ as given to take()
+		inline void give_back(char* block_, size_t alignment_) noexcept {
+			char* const raw_ = alignment_ <= heap_alignment ? block_ : ((char**)block_)[-1];
+			DBJ_NANO_FREE(raw_);
+		}
+
+	} // heap_aligned
+
+	struct block_source final {
+
+		enum class kind { heap, mapped };
+
+		constexpr static size_t page_size{ 0x1000 };
+		constexpr static size_t huge_page_size{ 0x200000 };
+
+		kind from{ kind::heap };
+		bool huge_pages{};
+		bool populate{};
+		/// of the block start, a power of two, up to the page size, 0 is the heap default
+		size_t alignment{};
+
+		constexpr static block_source heap() noexcept { return {}; }
+		constexpr static block_source mapped(bool populate_ = false) noexcept { return { kind::mapped, false, populate_ }; }
+		constexpr static block_source huge(bool populate_ = false) noexcept { return { kind::mapped, true, populate_ }; }
+
+		/// the same source, blocks aligned to alignment_
+		constexpr block_source aligned_to(size_t alignment_) const noexcept {
+			return { from, huge_pages, populate, alignment_ };
+		}
+
+		bool is_mapped() const noexcept { return DBJ_BLOCK_SOURCE_HAS_MAPPING && from == kind::mapped; }
+
+		const char* name() const noexcept {
+			if (!is_mapped()) return "heap";
+			if (huge_pages) return populate ? "huge pages, populated" : "huge pages";
+			return populate ? "mapped, populated" : "mapped";
+		}
+
+		/// bytes taken for size_ bytes, give_back() needs them
+		size_t taken_size(size_t size_) const noexcept {
+			if (!is_mapped()) return size_;
+			const size_t unit_ = huge_pages ? huge_page_size : page_size;
+			return (size_ + unit_ - 1) & ~(unit_ - 1);
+		}
+
+		/// null on failure
+		char* take(size_t size_) const noexcept {
+			_ASSERTE(alignment <= page_size && (alignment & (alignment - 1)) == 0);
+			if (!is_mapped()) return heap_aligned::take(size_, alignment);
+
+			const size_t taken_ = taken_size(size_);
+			char* block_ = map(taken_);
+			if (block_ && populate)
+				// MAP_POPULATE would fault in the ends trimmed too
+				for (size_t j = 0; j < taken_; j += page_size)
+					((volatile char*)block_)[j] = 0;
+			return block_;
+		}
+
+		/// size_ as returned by taken_size()
+		void give_back(char* block_, size_t size_) const noexcept {
+			if (!is_mapped()) {
+				heap_aligned::give_back(block_, alignment);
+				return;
+			}
+#if defined(__linux__)
+			::munmap(block_, size_);
+#elif defined(_WIN32)
+			(void)size_;
+			::VirtualFree(block_, 0, MEM_RELEASE);
+#else
+			// as map() takes it
+			(void)size_;
+			DBJ_NANO_FREE(block_);
+#endif
+		}
+
+		/// pages of the block are given back, the block is kept, its contents are not
+		/// block_ is page aligned, the last page, which is not whole, is kept
+		void decommit(char* block_, size_t size_) const noexcept {
+			if (!is_mapped()) return;
+			size_ &= ~(page_size - 1);
+			if (size_ == 0) return;
+#if defined(__linux__)
+			::madvise(block_, size_, MADV_DONTNEED);
+#elif defined(_WIN32)
+			// no decommit, thus no recommit to fail, the pages may be dropped
+			::VirtualAlloc(block_, size_, MEM_RESET, PAGE_READWRITE);
+#else
+			(void)block_; (void)size_;
+#endif
+		}
+
+	private:
+
+		char* map(size_t size_) const noexcept {
+#if defined(__linux__)
+			constexpr int protection_ = PROT_READ | PROT_WRITE;
+			constexpr int flags_ = MAP_PRIVATE | MAP_ANONYMOUS;
+			if (!huge_pages) {
+				void* block_ = ::mmap(nullptr, size_, protection_, flags_, -1, 0);
+				return block_ == MAP_FAILED ? nullptr : (char*)block_;
+			}
+			// 2 MiB aligned, one huge page more is mapped, the ends are trimmed
+			void* raw_ = ::mmap(nullptr, size_ + huge_page_size, protection_, flags_, -1, 0);
+			if (raw_ == MAP_FAILED) return nullptr;
+			char* const start_ = (char*)(((uintptr_t)raw_ + huge_page_size - 1) & ~(uintptr_t)(huge_page_size - 1));
+			char* const end_ = (char*)raw_ + size_ + huge_page_size;
+			if (start_ > (char*)raw_) ::munmap(raw_, size_t(start_ - (char*)raw_));
+			if (end_ > start_ + size_) ::munmap(start_ + size_, size_t(end_ - (start_ + size_)));
+#ifdef MADV_HUGEPAGE
+			::madvise(start_, size_, MADV_HUGEPAGE);
+#endif // MADV_HUGEPAGE
+			return start_;
+#elif defined(_WIN32)
+			// large pages need SeLockMemoryPrivilege, they are not used
+			return (char*)::VirtualAlloc(nullptr, size_, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+			return DBJ_NANO_MALLOC(char, size_);
+#endif
+		}
+	}; // block_source
+
+} // dbj::shohnikov
+
+#endif // DBJ_BLOCK_SOURCE_INC
@@ -0,0 +1,496 @@
+#ifndef DBJ_CONCURRENT_POOL_INC
+#define DBJ_CONCURRENT_POOL_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Thread safe variant of the dbj_pool_allocator.
+
+ Each thread has its own cache of two magazines, a magazine is an array
+ of free chunks. Allocate and deallocate are served from them, no locks
+ and no atomics on that path.
+
+ Magazines are exchanged, full for empty and empty for full, with the
+ depot. The depot is two lock free stacks, of full and of empty magazines.
+
+ Each chunk remembers the cache it was allocated from. A chunk freed on
+ another thread is returned to that cache, over its lock free remote free
+ list, which the owner takes in one go when its magazines run dry.
+
+ New blocks and new magazines are made under the one mutex.
+
+ When a thread ends, its magazines go to the depot and its cache is left
+ to be adopted by the next thread which needs one. Chunks freed remotely
+ to the cache left, wait there for the adopter.
+
+ Bonwick, Adams, "Magazines and Vmem", USENIX 2001
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "dbj_shoshnikov_pool_allocator.h"
+
+namespace dbj::shohnikov {
+
+	struct dbj_concurrent_pool_allocator;
+
+	namespace concurrent {
+
+		constexpr static size_t magazine_capacity{ 64 };
+		/// slab j holds first_slab_magazines << j magazines, the slabs double
+		/// thus that many slabs hold every magazine a 32 bit index can name
+		constexpr static size_t first_slab_magazines{ 0x100 };
+		constexpr static size_t max_magazine_slabs{ 24 };
+		static_assert(first_slab_magazines * ((size_t(1) << max_magazine_slabs) - 1) <= UINT32_MAX);
+		constexpr static size_t cache_line_size{ 64 };
+
+		struct thread_cache;
+
+		/// in front of each chunk, user data follows
+		/// null while the chunk is free
+		struct chunk_header final {
+			thread_cache* owner{};
+		};
+
+		constexpr static size_t chunk_header_size_ = align(sizeof(chunk_header));
+
+		inline chunk_header* header_from_data(void* data_) noexcept {
+			return (chunk_header*)((char*)data_ - chunk_header_size_);
+		}
+
+		inline void* data_from_header(chunk_header* header_) noexcept {
+			return (char*)header_ + chunk_header_size_;
+		}
+
+		/// ------------------------------------------------------------------------
+		struct magazine final {
+			/// next on the depot stack, 0 is none
+			std::atomic<uint32_t> next{};
+			/// 1 based, constant
+			uint32_t index{};
+			uint32_t count{};
+			chunk_header* chunks[magazine_capacity]{};
+		};
+
+		/// ------------------------------------------------------------------------
+		/// lock free stacks of full and of empty magazines
+		/// magazines are known by their index, the upper half of the stack
+		/// head is a tag, incremented on each change, against the ABA
+		/// magazines are made under the pool mutex and live as long as the depot
+		/// they are never moved, thus the slabs double instead of being chained
+		/// and the magazine is found by its index in constant time
+		class magazine_depot final {
+
+			magazine* slabs_[max_magazine_slabs]{};
+			uint32_t magazine_count_{};
+
+			/// magazines in the slabs before slab_
+			constexpr static size_t slab_start(size_t slab_) noexcept {
+				return first_slab_magazines * ((size_t(1) << slab_) - 1);
+			}
+
+			constexpr static size_t slab_of(size_t position_) noexcept {
+				const size_t doubling_ = position_ / first_slab_magazines + 1;
+				size_t slab_{};
+				while ((doubling_ >> (slab_ + 1)) != 0) ++slab_;
+				return slab_;
+			}
+
+			std::atomic<uint64_t> full_{ 0 };
+			std::atomic<uint64_t> empty_{ 0 };
+
+			magazine* at(uint32_t index_) const noexcept {
+				const size_t slab_ = slab_of(index_ - 1);
+				return &slabs_[slab_][index_ - 1 - slab_start(slab_)];
+			}
+
+			static void push(std::atomic<uint64_t>& head_, magazine* mag_) noexcept {
+				uint64_t old_ = head_.load(std::memory_order_relaxed);
+				do {
+					mag_->next.store(uint32_t(old_), std::memory_order_relaxed);
+				} while (!head_.compare_exchange_weak(old_,
+					(((old_ >> 32) + 1) << 32) | mag_->index,
+					std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			magazine* pop(std::atomic<uint64_t>& head_) noexcept {
+				uint64_t old_ = head_.load(std::memory_order_acquire);
+				for (;;) {
+					const uint32_t index_ = uint32_t(old_);
+					if (index_ == 0) return nullptr;
+					magazine* mag_ = at(index_);
+					const uint64_t new_ = (((old_ >> 32) + 1) << 32) | mag_->next.load(std::memory_order_relaxed);
+					if (head_.compare_exchange_weak(old_, new_, std::memory_order_acquire, std::memory_order_acquire))
+						return mag_;
+				}
+			}
+
+		public:
+			magazine_depot() noexcept = default;
+			~magazine_depot() {
+				for (magazine* slab_ : slabs_) {
+					if (slab_ == nullptr) break;
+					delete[] slab_;
+				}
+			}
+
+			magazine_depot(magazine_depot const&) = delete;
+			magazine_depot& operator = (magazine_depot const&) = delete;
+
+			void push_full(magazine* mag_) noexcept { push(full_, mag_); }
+			void push_empty(magazine* mag_) noexcept { push(empty_, mag_); }
+			magazine* pop_full() noexcept { return pop(full_); }
+			magazine* pop_empty() noexcept { return pop(empty_); }
+
+			/// caller holds the pool mutex
+			/// std::bad_alloc if the system, or the 32 bit index, is out of them
+			magazine* make_magazine() {
+				if (magazine_count_ == slab_start(max_magazine_slabs)) throw std::bad_alloc();
+				const size_t slab_ = slab_of(magazine_count_);
+				if (slabs_[slab_] == nullptr) {
+					const size_t size_ = first_slab_magazines << slab_;
+					slabs_[slab_] = new magazine[size_]{};
+					for (size_t j = 0; j < size_; ++j)
+						slabs_[slab_][j].index = uint32_t(slab_start(slab_) + j + 1);
+				}
+				return at(++magazine_count_);
+			}
+		};
+
+		/// ------------------------------------------------------------------------
+		struct alignas(cache_line_size) thread_cache final {
+			magazine* loaded{};
+			/// always full or empty
+			magazine* previous{};
+			/// all the caches of one pool, guarded by the pool mutex
+			thread_cache* next_cache{};
+			/// false while left by the thread which ended
+			std::atomic<bool> owned{};
+			/// chunks freed on the other threads, pushed one by one and
+			/// taken all at once; the link is in the chunk data
+			alignas(cache_line_size) std::atomic<void*> remote_free{};
+		};
+
+		/// ------------------------------------------------------------------------
+		/// pools alive, the thread exit must not touch the caches of the
+		/// pool which is gone, pool ids are never reused
+		struct live_pools final {
+			std::mutex mutex{};
+			std::vector<uint64_t> ids{};
+			uint64_t next_id{ 1 };
+
+			bool alive(uint64_t id_) const noexcept {
+				for (uint64_t j : ids) if (j == id_) return true;
+				return false;
+			}
+
+			static live_pools& instance() {
+				static live_pools pools_{};
+				return pools_;
+			}
+		};
+
+		struct cache_entry final {
+			uint64_t pool_id{};
+			dbj_concurrent_pool_allocator* pool{};
+			thread_cache* cache{};
+		};
+
+		/// the cache used last on this thread, no guard, no destructor
+		inline cache_entry& last_cache_used() noexcept {
+			static thread_local cache_entry last_{};
+			return last_;
+		}
+
+		/// all the caches of this thread, given up when it ends
+		struct thread_caches final {
+			std::vector<cache_entry> entries{};
+			~thread_caches();
+
+			static thread_caches& local() {
+				static thread_local thread_caches caches_{};
+				return caches_;
+			}
+		};
+
+	} // concurrent
+
+	/// ---------------------------------------------------------------------------
+	/// same interface as dbj_pool_allocator
+	struct dbj_concurrent_pool_allocator final
+	{
+		using magazine = concurrent::magazine;
+		using thread_cache = concurrent::thread_cache;
+		using chunk_header = concurrent::chunk_header;
+
+		explicit dbj_concurrent_pool_allocator(legal_block_size chunksPerBlock, size_t chunk_size_arg,
+			block_source source_arg = {})
+			: chunks_per_block_(chunksPerBlock)
+			, chunk_size_(unaligned_size{
+				align(chunk_size_arg) < sizeof(void*) ? sizeof(void*) : align(chunk_size_arg) })
+			, chunk_stride_(concurrent::chunk_header_size_ + chunk_size_.val)
+			, block_registry_(source_arg)
+		{
+			concurrent::live_pools& live_ = concurrent::live_pools::instance();
+			std::lock_guard<std::mutex> guard_(live_.mutex);
+			id_ = live_.next_id++;
+			live_.ids.push_back(id_);
+		}
+
+		~dbj_concurrent_pool_allocator() {
+			{
+				concurrent::live_pools& live_ = concurrent::live_pools::instance();
+				std::lock_guard<std::mutex> guard_(live_.mutex);
+				for (uint64_t& j : live_.ids)
+					if (j == id_) { std::swap(j, live_.ids.back()); live_.ids.pop_back(); break; }
+			}
+			while (caches_) {
+				thread_cache* next_ = caches_->next_cache;
+				delete caches_;
+				caches_ = next_;
+			}
+		}
+
+		dbj_concurrent_pool_allocator() = delete;
+		dbj_concurrent_pool_allocator(dbj_concurrent_pool_allocator const&) = delete;
+		dbj_concurrent_pool_allocator& operator = (dbj_concurrent_pool_allocator const&) = delete;
+		dbj_concurrent_pool_allocator(dbj_concurrent_pool_allocator&&) = delete;
+		dbj_concurrent_pool_allocator& operator = (dbj_concurrent_pool_allocator&&) = delete;
+
+		/// null if the system is out of memory
+		void* allocate() {
+			thread_cache& cache_ = local_cache();
+			magazine* loaded_ = cache_.loaded;
+			if (loaded_->count == 0) {
+				if (!refill(cache_)) return nullptr;
+				loaded_ = cache_.loaded;
+			}
+			chunk_header* chunk_ = loaded_->chunks[--loaded_->count];
+			chunk_->owner = &cache_;
+			return concurrent::data_from_header(chunk_);
+		}
+
+		/// on any thread
+		void deallocate(void* chunk_data_) {
+			chunk_header* chunk_ = concurrent::header_from_data(chunk_data_);
+			thread_cache* owner_ = chunk_->owner;
+			// freed twice, or not from this pool
+			_ASSERTE(owner_ != nullptr);
+			chunk_->owner = nullptr;
+
+			thread_cache& cache_ = local_cache();
+			if (owner_ == &cache_ || !owner_->owned.load(std::memory_order_relaxed))
+				free_local(cache_, chunk_);
+			else
+				free_remote(*owner_, chunk_data_);
+		}
+
+		/// number of blocks taken from the system so far
+		size_t block_count() const noexcept {
+			return block_count_.load(std::memory_order_relaxed);
+		}
+
+		/// bytes taken from the system so far
+		size_t footprint() const noexcept {
+			return block_count() * size_t(chunks_per_block_) * chunk_stride_;
+		}
+
+	private:
+		friend struct concurrent::thread_caches;
+
+		thread_cache& local_cache() {
+			concurrent::cache_entry& last_ = concurrent::last_cache_used();
+			if (last_.pool_id == id_) return *last_.cache;
+			return local_cache_slow();
+		}
+
+		thread_cache& local_cache_slow();
+
+		/// caller holds the mutex
+		/// a cache left by the thread which ended, or a new one
+		thread_cache* adopt_or_make_cache() {
+			for (thread_cache* cache_ = caches_; cache_; cache_ = cache_->next_cache) {
+				bool left_ = false;
+				if (cache_->owned.compare_exchange_strong(left_, true, std::memory_order_acquire))
+					return cache_;
+			}
+			thread_cache* cache_ = new thread_cache{};
+			cache_->loaded = depot_.make_magazine();
+			cache_->previous = depot_.make_magazine();
+			cache_->owned.store(true, std::memory_order_relaxed);
+			cache_->next_cache = caches_;
+			caches_ = cache_;
+			return cache_;
+		}
+
+		magazine* empty_magazine() {
+			if (magazine* mag_ = depot_.pop_empty()) return mag_;
+			std::lock_guard<std::mutex> guard_(mutex_);
+			return depot_.make_magazine();
+		}
+
+		void free_local(thread_cache& cache_, chunk_header* chunk_) {
+			magazine* loaded_ = cache_.loaded;
+			if (loaded_->count == concurrent::magazine_capacity) {
+				if (cache_.previous->count == 0) {
+					std::swap(cache_.loaded, cache_.previous);
+				}
+				else {
+					depot_.push_full(cache_.previous);
+					cache_.previous = cache_.loaded;
+					cache_.loaded = empty_magazine();
+				}
+				loaded_ = cache_.loaded;
+			}
+			loaded_->chunks[loaded_->count++] = chunk_;
+		}
+
+		static void free_remote(thread_cache& owner_, void* chunk_data_) noexcept {
+			void* head_ = owner_.remote_free.load(std::memory_order_relaxed);
+			do {
+				*(void**)chunk_data_ = head_;
+			} while (!owner_.remote_free.compare_exchange_weak(head_, chunk_data_,
+				std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		/// false if nothing was freed remotely
+		bool take_remote(thread_cache& cache_) {
+			void* list_ = cache_.remote_free.exchange(nullptr, std::memory_order_acquire);
+			if (list_ == nullptr) return false;
+			while (list_) {
+				void* next_ = *(void**)list_;
+				free_local(cache_, concurrent::header_from_data(list_));
+				list_ = next_;
+			}
+			return true;
+		}
+
+		/// loaded is empty, previous is full or empty
+		/// false if the system is out of memory
+		bool refill(thread_cache& cache_) {
+			if (cache_.previous->count > 0) {
+				std::swap(cache_.loaded, cache_.previous);
+				return true;
+			}
+			if (take_remote(cache_) && cache_.loaded->count > 0)
+				return true;
+			if (magazine* full_ = depot_.pop_full()) {
+				depot_.push_empty(cache_.previous);
+				cache_.previous = cache_.loaded;
+				cache_.loaded = full_;
+				return true;
+			}
+			return grow(cache_);
+		}
+
+		/// new block, its chunks go to the loaded magazine, which is empty,
+		/// the rest to the depot
+		bool grow(thread_cache& cache_) {
+			std::lock_guard<std::mutex> guard_(mutex_);
+
+			const size_t number_of_chunks_ = size_t(chunks_per_block_);
+			char* const block_ = block_registry_.source().take(number_of_chunks_ * chunk_stride_);
+			if (block_ == nullptr) return false;
+#ifndef NDEBUG
+			memset(block_, 0, number_of_chunks_ * chunk_stride_);
+#endif
+			block_registry_.append(block_, number_of_chunks_ * chunk_stride_,
+				block_registry_.source().taken_size(number_of_chunks_ * chunk_stride_));
+			block_count_.fetch_add(1, std::memory_order_relaxed);
+
+			magazine* filling_ = cache_.loaded;
+			_ASSERTE(filling_->count == 0);
+			for (size_t j = 0; j < number_of_chunks_; ++j) {
+				if (filling_->count == concurrent::magazine_capacity) {
+					if (filling_ != cache_.loaded) depot_.push_full(filling_);
+					filling_ = depot_.pop_empty();
+					if (filling_ == nullptr) filling_ = depot_.make_magazine();
+				}
+				chunk_header* chunk_ = (chunk_header*)(block_ + j * chunk_stride_);
+				chunk_->owner = nullptr;
+				filling_->chunks[filling_->count++] = chunk_;
+			}
+			if (filling_ != cache_.loaded) depot_.push_full(filling_);
+			return true;
+		}
+
+		/// called on the thread which ends, while the pool is alive
+		void leave_cache(thread_cache& cache_) {
+			take_remote(cache_);
+			for (magazine** mag_ : { &cache_.loaded, &cache_.previous }) {
+				if ((*mag_)->count == 0) continue;
+				depot_.push_full(*mag_);
+				*mag_ = empty_magazine();
+			}
+			cache_.owned.store(false, std::memory_order_release);
+		}
+
+		const legal_block_size chunks_per_block_{};
+		const unaligned_size chunk_size_{};
+		/// header and the aligned chunk size
+		const size_t chunk_stride_{};
+		uint64_t id_{};
+
+		/// guards the blocks, making of the magazines and the caches list
+		std::mutex mutex_{};
+		chunky::block_registry block_registry_;
+		std::atomic<size_t> block_count_{ 0 };
+		concurrent::magazine_depot depot_{};
+		thread_cache* caches_{};
+	}; // dbj_concurrent_pool_allocator
+
+	/// ---------------------------------------------------------------------------
+	inline dbj_concurrent_pool_allocator::thread_cache& dbj_concurrent_pool_allocator::local_cache_slow()
+	{
+		concurrent::thread_caches& mine_ = concurrent::thread_caches::local();
+		concurrent::cache_entry& last_ = concurrent::last_cache_used();
+
+		for (concurrent::cache_entry& entry_ : mine_.entries)
+			if (entry_.pool_id == id_) {
+				last_ = entry_;
+				return *entry_.cache;
+			}
+
+		{
+			// forget the pools which are gone
+			concurrent::live_pools& live_ = concurrent::live_pools::instance();
+			std::lock_guard<std::mutex> guard_(live_.mutex);
+			auto& entries_ = mine_.entries;
+			for (size_t j = 0; j < entries_.size(); )
+				if (!live_.alive(entries_[j].pool_id)) {
+					entries_[j] = entries_.back();
+					entries_.pop_back();
+				}
+				else ++j;
+		}
+
+		thread_cache* cache_{};
+		{
+			std::lock_guard<std::mutex> guard_(mutex_);
+			cache_ = adopt_or_make_cache();
+		}
+		mine_.entries.push_back({ id_, this, cache_ });
+		last_ = mine_.entries.back();
+		return *cache_;
+	}
+
+	/// the live pools mutex is held, thus the pool can not go away meanwhile
+	inline concurrent::thread_caches::~thread_caches()
+	{
+		live_pools& live_ = live_pools::instance();
+		std::lock_guard<std::mutex> guard_(live_.mutex);
+		for (cache_entry& entry_ : entries)
+			if (live_.alive(entry_.pool_id))
+				entry_.pool->leave_cache(*entry_.cache);
+		last_cache_used() = cache_entry{};
+	}
+
+} // dbj::shohnikov
+
+#endif // DBJ_CONCURRENT_POOL_INC
@@ -0,0 +1,199 @@
+#ifndef DBJ_POOLS_INC
+#define DBJ_POOLS_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ Many pools of different chunk sizes behind one malloc / free facade.
+ See dbj_concept/planning/architecture.md, "dbj_pools".
+
+ Sizes are mapped to geometric size classes, two per doubling, from 16
+ to 2048 bytes, each served by one dbj_pool_allocator. All the chunk
+ sizes are multiples of 16, thus all the chunks are 16 bytes aligned.
+ Larger sizes are given to the system allocator.
+
+ free() has no size, the owner of the address is found in the address
+ map, a sorted array of all the blocks of all the pools. The last block
+ found is checked first. Addresses not in the map are from the system.
+
+ The pools never sweep on their own, the map would not know, sweep_blocks()
+ here sweeps them all and makes the map again.
+
+ Not thread safe, as the pools are not.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "dbj_shoshnikov_pool_allocator.h"
+
+namespace dbj::shohnikov {
+
+	namespace size_classes {
+
+		constexpr static size_t granule{ 16 };
+		constexpr static size_t max_size{ 2048 };
+
+		/// 16, 32, then two per doubling, 48, 64, 96, 128 ...
+		constexpr static size_t sizes[]{
+			16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+		};
+
+		constexpr static size_t count = sizeof(sizes) / sizeof(sizes[0]);
+
+		/// the smallest class which fits, for each number of granules
+		struct lookup_table final {
+			uint8_t class_of[max_size / granule + 1]{};
+
+			constexpr lookup_table() noexcept {
+				size_t class_ = 0;
+				for (size_t j = 0; j <= max_size / granule; ++j) {
+					while (sizes[class_] < j * granule) ++class_;
+					class_of[j] = uint8_t(class_);
+				}
+			}
+		};
+
+		constexpr static lookup_table lookup{};
+
+		/// size_ must not be larger than max_size
+		constexpr size_t class_of(size_t size_) noexcept {
+			return lookup.class_of[(size_ + granule - 1) / granule];
+		}
+
+		/// blocks of about 64KB, at least 16 chunks
+		constexpr legal_block_size chunks_per_block(size_t class_) noexcept {
+			size_t chunks_ = 16;
+			while (chunks_ * 2 * sizes[class_] <= 0x10000) chunks_ *= 2;
+			return legal_block_size(chunks_);
+		}
+
+		static_assert(class_of(1) == 0 && class_of(16) == 0 && class_of(17) == 1);
+		static_assert(class_of(max_size) == count - 1);
+		static_assert(sizes[count - 1] == max_size);
+
+	} // size_classes
+
+	struct dbj_pools final
+	{
+		dbj_pools()
+		{
+			for (size_t j = 0; j < size_classes::count; ++j)
+				pools_[j] = std::make_unique<dbj_pool_allocator>(
+					size_classes::chunks_per_block(j), size_classes::sizes[j]);
+		}
+
+		~dbj_pools() = default;
+
+		dbj_pools(dbj_pools const&) = delete;
+		dbj_pools& operator = (dbj_pools const&) = delete;
+		dbj_pools(dbj_pools&&) = delete;
+		dbj_pools& operator = (dbj_pools&&) = delete;
+
+		/// null only if the system is out of memory
+		void* malloc(size_t size_) {
+			if (size_ > size_classes::max_size)
+				return ::malloc(size_);
+
+			const size_t class_ = size_classes::class_of(size_);
+			dbj_pool_allocator& pool_ = *pools_[class_];
+			void* chunk_ = pool_.allocate();
+			// a new block, it goes to the map
+			if (pool_.block_count() != mapped_blocks_[class_])
+				rebuild_map();
+			return chunk_;
+		}
+
+		void free(void* block_) {
+			if (block_ == nullptr) return;
+			const map_entry* owner_ = find(block_);
+			if (owner_)
+				pools_[owner_->size_class]->deallocate(block_);
+			else
+				::free(block_);
+		}
+
+		/// chunk size of the class, or 0 if not from the pools
+		size_t usable_size(void const* block_) const noexcept {
+			const map_entry* owner_ = find(block_);
+			return owner_ ? size_classes::sizes[owner_->size_class] : 0;
+		}
+
+		/// empty blocks of all the pools are given back to the system
+		/// returns the number of blocks freed
+		size_t sweep_blocks() {
+			size_t swept_{};
+			for (auto& pool_ : pools_)
+				swept_ += pool_->sweep_blocks();
+			if (swept_) rebuild_map();
+			return swept_;
+		}
+
+		/// of all the pools
+		size_t block_count() const noexcept {
+			size_t count_{};
+			for (auto const& pool_ : pools_) count_ += pool_->block_count();
+			return count_;
+		}
+
+		/// of all the pools, the system allocations are not counted
+		size_t footprint() const noexcept {
+			size_t bytes_{};
+			for (auto const& pool_ : pools_) bytes_ += pool_->footprint();
+			return bytes_;
+		}
+
+		dbj_pool_allocator const& pool(size_t class_) const noexcept {
+			_ASSERTE(class_ < size_classes::count);
+			return *pools_[class_];
+		}
+
+	private:
+
+		struct map_entry final {
+			char const* start{};
+			char const* end{};
+			size_t size_class{};
+		};
+
+		/// binary search, the last one found is checked first
+		const map_entry* find(void const* address_) const noexcept {
+			char const* const where_ = (char const*)address_;
+			if (last_found_ && where_ >= last_found_->start && where_ < last_found_->end)
+				return last_found_;
+
+			auto next_ = std::upper_bound(map_.begin(), map_.end(), where_,
+				[](char const* a_, map_entry const& e_) { return a_ < e_.start; });
+			if (next_ == map_.begin()) return nullptr;
+			const map_entry* entry_ = &*(next_ - 1);
+			if (where_ >= entry_->end) return nullptr;
+			last_found_ = entry_;
+			return entry_;
+		}
+
+		/// made again on each block taken or given back, that is rare
+		void rebuild_map() {
+			map_.clear();
+			for (size_t j = 0; j < size_classes::count; ++j) {
+				pools_[j]->block_registry_.for_each_descriptor([&](chunky::block_descriptor const& block_) {
+					map_.push_back({ block_.start, block_.start + block_.size, j });
+				});
+				mapped_blocks_[j] = pools_[j]->block_count();
+			}
+			std::sort(map_.begin(), map_.end(),
+				[](map_entry const& a_, map_entry const& b_) { return a_.start < b_.start; });
+			last_found_ = nullptr;
+		}
+
+		std::unique_ptr<dbj_pool_allocator> pools_[size_classes::count]{};
+		size_t mapped_blocks_[size_classes::count]{};
+		std::vector<map_entry> map_{};
+		mutable const map_entry* last_found_{ nullptr };
+	}; // dbj_pools
+
+} // dbj::shohnikov
+
+#endif // DBJ_POOLS_INC
@@ -3,12 +3,25 @@
 
 #define POOL_ALLOC_INSTRUMENTATION 1
 
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "dbj_block_source.h"
+
 // DBJ added
 // NOTE: NDEBUG is standard !
 #if !defined( _DEBUG ) &&  !defined( DEBUG ) && !defined(NDEBUG) 
 #define NDEBUG
 #endif // !_DEBUG and !DEBUG and NDEBUG
 
+// DBJ added
+// chunks have no header, their in use state is kept only when validating
+// by default in debug builds
+#if !defined(DBJ_POOL_VALIDATION) && !defined(NDEBUG)
+#define DBJ_POOL_VALIDATION 1
+#endif // !DBJ_POOL_VALIDATION and !NDEBUG
+
 namespace dbj::shohnikov {
 
 	// DBJ added
@@ -17,9 +30,6 @@ namespace dbj::shohnikov {
 		_2048 = 2048, _4096 = 4096, _8192 = 8192, _16384 = 16384, _32768 = 32768, _65536 = 65536
 	};
 
-	// DBJ added sanity constants
-	constexpr static auto max_number_of_blocks{ 0xFF };
-
 	/**
 	* Machine word size. Depending on the architecture,
 	* can be 4 or 8 bytes.
@@ -35,123 +45,315 @@ namespace dbj::shohnikov {
 
 	struct unaligned_size { size_t val{}; };
 
+	/// DBJ added
+	/// of each chunk, a power of two, up to the page size
+	/// the chunk size is rounded up to it, blocks are aligned to it
+	/// cache_line_isolated: no two chunks share a cache line, no false
+	/// sharing between the objects used from different threads
+	struct chunk_alignment final {
+		size_t val{ sizeof(word_t) };
+		constexpr static size_t cache_line_size{ 64 };
+	};
+
+	constexpr chunk_alignment cache_line_isolated{ chunk_alignment::cache_line_size };
+
+	/// DBJ added
+	/// lifo: one free list for the pool, freed chunk is the next allocated
+	/// per_block: each block has its own free list, chunks are allocated
+	/// from the fullest block which is not full, of those from the one
+	/// with the lowest address, hot objects are packed into fewer pages
+	/// and the other blocks have a chance to become empty
+	enum class free_list_policy { lifo, per_block };
+
+	/// DBJ added
+	/// empty blocks are given back to the system when there are more than
+	/// high_water of them, low_water of them are kept for the next burst
+	/// the default is never
+	/// free_list_policy::lifo sweep walks the pool free list, thus it is
+	/// made only after as many chunks are freed as the last one has left
+	/// on the list, there may be more than high_water empty blocks till then
+	struct sweep_policy final {
+		size_t high_water{ SIZE_MAX };
+		size_t low_water{ 0 };
+	};
+
 	namespace chunky {
 
 		/// ------------------------------------------------------------------------
 /// pool has to own it, called from pools destructor
 /// why this? std::vector is overkill
 /// NOTE: in here there is no knowledge of Chunk
+///
+/// DBJ: chained arrays of block descriptors, no capacity limit
+/// the first array is inside the registry, the rest are heap allocated
+/// and never moved, descriptors keep their addresses until remove_if()
+		struct block_descriptor final {
+			char* start{};
+			size_t size{};
+			/// from the block source, the in use bitmap included
+			size_t taken{};
+			/// chunks in use, kept by the pool
+			size_t live{};
+			/// free chunks of this block, for the pool which keeps them per block
+			void* free_list{};
+			/// chunks below are carved, above are never used, not even touched
+			char* bump{};
+			/// marked by the pool for remove_if()
+			bool to_release{};
+
+			bool contains(void const* address_) const noexcept {
+				return (char const*)address_ >= start && (char const*)address_ < start + size;
+			}
+
+			bool carved_out() const noexcept { return bump == start + size; }
+			/// bytes never used
+			size_t uncarved() const noexcept { return size_t(start + size - bump); }
+		};
+
 		class block_registry final {
-			constexpr static int max_blocks{ 0xFF };
-			char* blocks_[max_blocks]{ 0 };
-			int level_{ 0 };
+			constexpr static size_t blocks_per_segment{ 0xFF };
+
+			struct segment final {
+				block_descriptor blocks_[blocks_per_segment]{};
+				segment* next_{ nullptr };
+			};
+
+			block_source source_{};
+			segment first_{};
+			segment* last_{ &first_ };
+			size_t level_{ 0 };
+
+			/// sorted by the block start, for find()
+			std::vector<block_descriptor*> by_address_{};
+			mutable block_descriptor* last_found_{ nullptr };
+
+			block_descriptor& push(block_descriptor const& desc_)
+			{
+				const size_t slot_ = level_ % blocks_per_segment;
+				if (slot_ == 0 && level_ > 0) {
+					segment* next_ = DBJ_NANO_MALLOC(segment, sizeof(segment));
+					// as the by_address_ insert in append() would
+					if (next_ == nullptr) throw std::bad_alloc();
+					new (next_) segment{};
+					last_->next_ = next_;
+					last_ = next_;
+				}
+				last_->blocks_[slot_] = desc_;
+				level_ += 1;
+				return last_->blocks_[slot_];
+			}
+
+			void free_segments() noexcept
+			{
+				segment* seg_ = first_.next_;
+				while (seg_) {
+					segment* next_ = seg_->next_;
+					DBJ_NANO_FREE(seg_);
+					seg_ = next_;
+				}
+				first_ = segment{};
+				last_ = &first_;
+				level_ = 0;
+				by_address_.clear();
+				last_found_ = nullptr;
+			}
+
 		public:
 
-			int next_block_index() const noexcept { return level_; };
+			size_t next_block_index() const noexcept { return level_; };
+
+			block_source const& source() const noexcept { return source_; }
 
 			/// return index of the block appended
-			int append(char* const new_block_)
+			/// taken_ is what was taken from the source for it
+			size_t append(char* const new_block_, size_t size_, size_t taken_)
 			{
-				_ASSERT(level_ < max_blocks );
-				blocks_[level_] = new_block_;
-				level_ += 1;
+				block_descriptor* desc_ = &push({ new_block_, size_, taken_, 0, nullptr, new_block_, false });
+				by_address_.insert(
+					std::upper_bound(by_address_.begin(), by_address_.end(), desc_,
+						[](block_descriptor const* a_, block_descriptor const* b_) { return a_->start < b_->start; }),
+					desc_);
 				return level_ - 1;
 			}
 
+			/// the block which contains the address, null if none
+			/// binary search, the last one found is checked first
+			block_descriptor* find(void const* address_) const noexcept
+			{
+				if (last_found_ && last_found_->contains(address_)) return last_found_;
+
+				auto pos_ = std::upper_bound(by_address_.begin(), by_address_.end(), address_,
+					[](void const* a_, block_descriptor const* b_) { return (char const*)a_ < b_->start; });
+				if (pos_ == by_address_.begin()) return nullptr;
+				block_descriptor* desc_ = *(pos_ - 1);
+				if (!desc_->contains(address_)) return nullptr;
+				return last_found_ = desc_;
+			}
+
 			template<typename CB_ >
 			void for_each(CB_ call_back_) const noexcept
 			{
-				for (int j = 0; j < max_blocks; ++j) {
-					if (blocks_[j] == nullptr) break;
-					call_back_(blocks_[j]);
-				}
+				size_t j = 0;
+				for (segment const* seg_ = &first_; seg_; seg_ = seg_->next_)
+					for (size_t k = 0; k < blocks_per_segment && j < level_; ++k, ++j)
+						call_back_(seg_->blocks_[k].start);
 			}
 
-			~block_registry() {
-				for (int j = 0; j < max_blocks; ++j) {
-					if (blocks_[j] == nullptr) break;
-					DBJ_NANO_FREE(blocks_[j]);
-#ifndef NDEBUG
-					blocks_[j] = nullptr;
-#endif
+			template<typename CB_ >
+			void for_each_descriptor(CB_ call_back_) noexcept
+			{
+				size_t j = 0;
+				for (segment* seg_ = &first_; seg_; seg_ = seg_->next_)
+					for (size_t k = 0; k < blocks_per_segment && j < level_; ++k, ++j)
+						call_back_(seg_->blocks_[k]);
+			}
+
+			template<typename CB_ >
+			void for_each_descriptor(CB_ call_back_) const noexcept
+			{
+				size_t j = 0;
+				for (segment const* seg_ = &first_; seg_; seg_ = seg_->next_)
+					for (size_t k = 0; k < blocks_per_segment && j < level_; ++k, ++j)
+						call_back_(seg_->blocks_[k]);
+			}
+
+			/// in the order of block addresses, lowest first
+			template<typename CB_ >
+			void for_each_by_address(CB_ call_back_) noexcept
+			{
+				for (block_descriptor* desc_ : by_address_)
+					call_back_(*desc_);
+			}
+
+			/// the blocks for which predicate is true are freed
+			/// the rest are compacted in place, thus their descriptors move
+			/// nothing is allocated, by_address_ shrinks in its own capacity
+			/// returns the number of blocks freed
+			template<typename PRED_ >
+			size_t remove_if(PRED_ predicate_) noexcept
+			{
+				size_t removed_{};
+				// the write position is never ahead of the read one
+				segment* to_segment_ = &first_;
+				size_t to_slot_{};
+				for_each_descriptor([&](block_descriptor& desc_) {
+					if (predicate_(desc_)) {
+						source_.give_back(desc_.start, desc_.taken);
+						++removed_;
+						return;
+					}
+					if (to_slot_ == blocks_per_segment) {
+						to_segment_ = to_segment_->next_;
+						to_slot_ = 0;
+					}
+					to_segment_->blocks_[to_slot_++] = desc_;
+				});
+				if (removed_ == 0) return 0;
+
+				// the segments left empty are freed
+				segment* seg_ = to_segment_->next_;
+				while (seg_) {
+					segment* next_ = seg_->next_;
+					DBJ_NANO_FREE(seg_);
+					seg_ = next_;
 				}
-				level_ = 0;
+				to_segment_->next_ = nullptr;
+				last_ = to_segment_;
+				level_ -= removed_;
+
+				by_address_.clear();
+				for_each_descriptor([&](block_descriptor& desc_) { by_address_.push_back(&desc_); });
+				std::sort(by_address_.begin(), by_address_.end(),
+					[](block_descriptor const* a_, block_descriptor const* b_) { return a_->start < b_->start; });
+				last_found_ = nullptr;
+				return removed_;
+			}
+
+			/// all the blocks and all the segments are freed
+			void release() noexcept
+			{
+				for_each_descriptor([&](block_descriptor& desc_) { source_.give_back(desc_.start, desc_.taken); });
+				free_segments();
 			}
 
-			explicit block_registry() noexcept = default;
+			~block_registry() { release(); }
+
+			explicit block_registry(block_source source_arg = {}) noexcept : source_(source_arg) {}
 			block_registry(block_registry const&) = delete;
 			block_registry& operator = (block_registry const&) = delete;
 			block_registry(block_registry&&) = delete;
 			block_registry& operator = (block_registry&&) = delete;
 		};
 
+		/**
+		 * DBJ: chunk has no header, it is the user data
+		 *
+		 * When a chunk is free, its first word is the `next`, the
+		 * address of the next chunk in a list.
+		 * When it's allocated, all of it is used by the user.
+		 *
+		 DBJ added next is ALSO null when a chunk is last c hunk in the last block in the pool
+		 */
 		struct Chunk {
-			/**
-			 * When a chunk is free, the `next` contains the
-			 * address of the next chunk in a list.
-			 *
-			 DBJ added next is ALSO null when a chunk is last c hunk in the last block in the pool
-			 */
 			Chunk* next{};
-			/*
-			 * DBJ added
-			 */
-			bool in_use{};
-			/*
-			 * When it's allocated, this space is used by
-			 * the user.
-			 */
-			word_t data[1]{};
 		};
 
+		constexpr static const size_t chunk_struct_size_ = align(sizeof(Chunk));
+
+		static_assert(sizeof(Chunk) == chunk_struct_size_);
+
 		/**
-		* Returns total allocation size, reserving in addition the space for
-		* the Chunk structure (object header + first data word).
-		*
-    	* Since the `word_t data[1]` already allocates one word inside the Block
-	    * structure, we decrease it from the size request: if a user allocates
-		* only one word, it's fully in the Block struct.
+		* DBJ: chunk size is the aligned size requested, free chunk
+		* must hold the `next` thus it is at least that big
 		*/
 		constexpr size_t chunk_allocation_size(unaligned_size size)
 		{
-			return align(size.val) + sizeof(Chunk) - sizeof(std::declval<Chunk>().data);
+			return align(size.val) < chunk_struct_size_ ? chunk_struct_size_ : align(size.val);
 		}
 
 		/// DBJ added
-		/// Also: https://godbolt.org/z/cCIgA_
-		constexpr static const size_t chunk_header_size_ = align(sizeof(Chunk*) + sizeof(bool) + sizeof(word_t[1]));
-		constexpr static const size_t chunk_struct_size_ = align(sizeof(Chunk));
-
-		static_assert(sizeof(Chunk) == chunk_struct_size_);
-
-		/*
-		
-		Apparently replaced with chunk->data
-
-		inline char* data_from_chunk(Chunk* chunk) {
-			return (char*)(chunk + sizeof(Chunk) - sizeof(std::declval<Chunk>().data) );
+		/// rounded up to the alignment, which is a power of two
+		constexpr size_t chunk_allocation_size(unaligned_size size, chunk_alignment alignment)
+		{
+			return (chunk_allocation_size(size) + alignment.val - 1) & ~(alignment.val - 1);
 		}
-		*/
 
-		Chunk* chunk_from_data (char* data) {
-			return (Chunk*)((char*)data + sizeof(std::declval<Chunk>().data) -
-				sizeof(Chunk));
+		inline Chunk* chunk_from_data (void* data) {
+			return (Chunk*)data;
 		}
 
-		inline size_t compute_raw_chunk_size(size_t chunk_size_arg)
+#ifdef DBJ_POOL_VALIDATION
+		/// DBJ added
+		/// one bit per chunk, set while in use, kept after the chunks of the block
+		constexpr size_t in_use_bitmap_size(size_t number_of_chunks_)
 		{
-			// aligned size of what user has requested
-			chunk_size_arg = align(chunk_size_arg);
-			// 
-			size_t size_ = chunk_header_size_ + chunk_size_arg;
-			// should be equal
-			_ASSERTE(align(size_) == size_);
-			return size_;
+			return ((number_of_chunks_ + 63) / 64) * sizeof(uint64_t);
 		}
 
+		struct in_use_bit final {
+			uint64_t* word{};
+			uint64_t mask{};
+
+			bool get() const noexcept { return (*word & mask) != 0; }
+			void set(bool in_use_) noexcept { if (in_use_) *word |= mask; else *word &= ~mask; }
+		};
+
+		inline in_use_bit in_use_of(block_descriptor const& block_, void const* chunk_, size_t chunk_allocation_size_) noexcept
+		{
+			const size_t index_ = size_t((char const*)chunk_ - block_.start) / chunk_allocation_size_;
+			uint64_t* bitmap_ = (uint64_t*)(block_.start + block_.size);
+			return { bitmap_ + index_ / 64, uint64_t(1) << (index_ % 64) };
+		}
+#endif // DBJ_POOL_VALIDATION
 
 		/// ------------------------------------------------------------------------
-		inline Chunk* allocateBlock(
+		/// DBJ added
+		/// block is registered, its chunks are not linked, nor touched
+		/// they are carved by the pool, by bumping the block bump pointer
+		/// thus the pages of the block are touched on the first use only
+		/// returns the block start, which is the first chunk
+		/// throws std::bad_alloc if the block source has no block
+		inline char* allocateRawBlock(
 			legal_block_size number_of_chunks_arg_,
 			unaligned_size chunk_size_arg_,
 			block_registry& registry_
@@ -171,34 +373,44 @@ namespace dbj::shohnikov {
 			/// <pointer - type>* const <pointer - name> = <memory - address>;
 			/// Note! This is NOT a pointer to a const.
 			///
-			char* const start_address =
-				DBJ_NANO_MALLOC( char, number_of_chunks_ * chunk_allocation_size_);
+#ifdef DBJ_POOL_VALIDATION
+			const size_t bitmap_size_ = in_use_bitmap_size(number_of_chunks_);
+#else
+			const size_t bitmap_size_ = 0;
+#endif
+			const size_t wanted_ = number_of_chunks_ * chunk_allocation_size_ + bitmap_size_;
+			char* const start_address = registry_.source().take(wanted_);
 
-			_ASSERTE(start_address);
+			// a block at null would be registered, its chunks given out
+			if (start_address == nullptr) throw std::bad_alloc();
 
-#ifndef NDEBUG
-			memset(start_address,0, number_of_chunks_ * chunk_allocation_size_ );
+#ifdef DBJ_POOL_VALIDATION
+			memset(start_address + number_of_chunks_ * chunk_allocation_size_, 0, bitmap_size_);
 #endif
 
-			registry_.append(start_address);
-
-			/// DBJ: also a const pointer...
-			Chunk* const retval_ = reinterpret_cast<Chunk*>(start_address);
+			registry_.append(start_address, number_of_chunks_ * chunk_allocation_size_, registry_.source().taken_size(wanted_));
+			return start_address;
+		}
 
-			char* chunk_walker = start_address;
-			Chunk* chunk{};
+		/// DBJ added
+		/// in front of each array, arrays are runs of chunks, see the pool array_allocate()
+		/// 16 bytes, just before the array, which starts at the chunk alignment
+		struct array_header final {
+			/// chunks of the run, 0 for the arrays too large for a block
+			size_t chunks{};
+			/// as requested
+			size_t size{};
+		};
+		static_assert(sizeof(array_header) == 16);
 
-			for (size_t i = 0; i < number_of_chunks_; ++i)
-			{
-				chunk = reinterpret_cast<Chunk*>(chunk_walker);
-				DBJ_ASSERT( chunk );
-				chunk->in_use = false; // DBJ added
-				chunk->next = reinterpret_cast<Chunk*>(chunk_walker + chunk_allocation_size_);
-				chunk_walker = chunk_walker + chunk_allocation_size_;
-			}
-			// ! the last chunk next field
-			chunk->next = nullptr;
-			return  retval_ ;
+		/// DBJ added
+		/// next never used chunk of the block, null if it is carved out
+		inline Chunk* carveChunk(block_descriptor& block_, size_t chunk_allocation_size_) noexcept
+		{
+			if (block_.carved_out()) return nullptr;
+			Chunk* const chunk_ = reinterpret_cast<Chunk*>(block_.bump);
+			block_.bump += chunk_allocation_size_;
+			return chunk_;
 		}
 
 	} // chunky
@@ -237,23 +449,40 @@ namespace dbj::shohnikov {
 		friend struct pool_alloc_instrument;
 #endif // POOL_ALLOC_INSTRUMENTATION
 
-		chunky::block_registry block_registry_{};
+		chunky::block_registry block_registry_;
 
 		using Chunk = chunky::Chunk;
 
-		explicit dbj_pool_allocator(legal_block_size chunksPerBlock, size_t chunk_size_arg)
+		explicit dbj_pool_allocator(legal_block_size chunksPerBlock, size_t chunk_size_arg,
+			sweep_policy policy_arg = {}, free_list_policy free_list_arg = free_list_policy::lifo,
+			block_source source_arg = {})
 			noexcept
-			: chunks_per_block_(chunksPerBlock)
+			: dbj_pool_allocator(chunksPerBlock, chunk_size_arg, chunk_alignment{},
+				policy_arg, free_list_arg, source_arg)
+		{
+		}
+
+		/// DBJ added
+		/// chunks aligned to alignment_arg, for the over-aligned types
+		/// or cache_line_isolated
+		explicit dbj_pool_allocator(legal_block_size chunksPerBlock, size_t chunk_size_arg,
+			chunk_alignment alignment_arg,
+			sweep_policy policy_arg = {}, free_list_policy free_list_arg = free_list_policy::lifo,
+			block_source source_arg = {})
+			noexcept
+			: block_registry_(source_arg.aligned_to(alignment_arg.val))
+			, chunks_per_block_(chunksPerBlock)
 			, chunk_size_(
-				unaligned_size{ 
-					( align(chunk_size_arg) < chunky::chunk_struct_size_ 
-					  ? chunky::chunk_struct_size_
-				      : chunk_size_arg )
-				}
+				unaligned_size{ chunky::chunk_allocation_size(unaligned_size{ chunk_size_arg }, alignment_arg) }
 			)
 			, next_free_chunk_(nullptr)
-
+			, alignment_(alignment_arg)
+			, sweep_policy_(policy_arg)
+			, free_list_policy_(free_list_arg)
 		{
+			_ASSERTE(sweep_policy_.low_water <= sweep_policy_.high_water);
+			_ASSERTE(alignment_.val >= sizeof(word_t) && alignment_.val <= block_source::page_size);
+			_ASSERTE((alignment_.val & (alignment_.val - 1)) == 0);
 		}
 
 		/// DBJ added
@@ -275,33 +504,41 @@ namespace dbj::shohnikov {
 		 *
 		 * DBJ: all block must contain chunks of the same size
 		 *      chunk size is constructor argument
+		 *      throws std::bad_alloc if a new block can not be made
 		 */
 		void* allocate() {
-			// No chunks left in the current block, or no any block
-			// exists yet. Allocate a new one, passing the chunk size:
-			if (next_free_chunk_ == nullptr)
-			{
-				next_free_chunk_ = chunky::allocateBlock(
-					this->chunks_per_block_, this->chunk_size_, this->block_registry_
-				);
-			}
+			// DBJ added
+			if (free_list_policy_ == free_list_policy::per_block)
+				return allocate_from_blocks();
 
 			// The return value is the current position of
 			// the allocation pointer:
 			Chunk* allocated_chunk = next_free_chunk_;
-
-			// Advance (bump) the allocation pointer to the next chunk.
-			// When no chunks left, the `next_free_chunk_` will be set to `nullptr`, and
-			// this will cause allocation of a new block on the next request:
-			next_free_chunk_ = next_free_chunk_->next;
+			chunky::block_descriptor* block_{};
+
+			if (allocated_chunk) {
+				// Advance the allocation pointer to the next free chunk
+				next_free_chunk_ = allocated_chunk->next;
+				// DBJ added
+				// the block of the chunk, for its live count, a binary search
+				// of the blocks unless it is the block found the last time
+				block_ = block_registry_.find(allocated_chunk);
+			}
+			else {
+				// DBJ: nothing freed, the next never used chunk is carved
+				// a new block is allocated when the bump block is carved out
+				block_ = &bump_block();
+				allocated_chunk = chunky::carveChunk(*block_, chunk_size_.val);
+			}
 
 			// DBJ added
-			// mark the chunk as "used"
-			allocated_chunk->in_use = true;
-			// take it out from a free list
-			allocated_chunk->next = nullptr;
+			_ASSERTE(block_ && allocated_chunk);
+			if (block_->live++ == 0) --empty_blocks_;
+
+			mark_in_use(*block_, allocated_chunk);
 
-			return allocated_chunk->data ;
+			// DBJ: no header, the chunk is the data
+			return allocated_chunk ;
 		}
 
 		/**
@@ -309,40 +546,443 @@ namespace dbj::shohnikov {
 		 */
 		void deallocate(void* chunk_data_)
 		{
-			Chunk* chunk = chunky::chunk_from_data((char*)chunk_data_);
+			Chunk* chunk = chunky::chunk_from_data(chunk_data_);
 			// DBJ added
-			// used chunk must have been marked as such
-			_ASSERTE(true == chunk->in_use);
-			// and the next must have been set to null
-			_ASSERTE(nullptr == chunk->next);
+			// chunk must be from this pool
+			// O(log blocks) when it is not from the block found the last time
+			chunky::block_descriptor* block_ = block_registry_.find(chunk);
+			_ASSERTE(block_ && block_->live > 0);
+
+			mark_free(*block_, chunk);
+			push_free(*block_, chunk);
 
 			// DBJ added
-			chunk->in_use = false;
+			++freed_since_sweep_;
+			if (--block_->live == 0) {
+				if (++empty_blocks_ > sweep_policy_.high_water)
+					policy_sweep();
+			}
+		}
+
+#ifdef DBJ_POOL_VALIDATION
+		/// DBJ added
+		/// for the instrumentation, chunk must be from this pool
+		bool in_use(void const* chunk_) const noexcept {
+			chunky::block_descriptor const* block_ = block_registry_.find(chunk_);
+			_ASSERTE(block_);
+			return chunky::in_use_of(*block_, chunk_, chunk_size_.val).get();
+		}
+#endif // DBJ_POOL_VALIDATION
 
-			// The freed chunk's next pointer points to the
-			// current allocation pointer:
-			chunk->next = next_free_chunk_;
-			// And the allocation pointer is moved backwards, and
-			// is set to the returned (now free) chunk:
-			next_free_chunk_ = chunk;
+		/// DBJ added
+		/// number of blocks taken from the system and not given back
+		size_t block_count() const noexcept {
+			return block_registry_.next_block_index();
+		}
+
+		/// DBJ added
+		/// bytes taken from the system and not given back
+		size_t footprint() const noexcept {
+			return block_count() * size_t(chunks_per_block_) * chunk_size_.val;
+		}
+
+		/// ------------------------------------------------------------
+		/// DBJ added
+		/// count_ chunks into out_, returns how many, that is count_
+		/// std::bad_alloc if a new block can not be made, those in out_ are taken
+		/// the free list is split in one walk, when it runs out chunks
+		/// are carved from the bump block, without linking them
+		size_t allocate_n(size_t count_, void** out_) {
+			size_t done_{};
+			while (done_ < count_) {
+				if (free_list_policy_ == free_list_policy::per_block) {
+					chunky::block_descriptor& block_ = allocation_block();
+					// one block only, live is counted once
+					done_ += take_n((Chunk**)&block_.free_list, &block_, count_ - done_, out_ + done_);
+					done_ += carve_n(block_, count_ - done_, out_ + done_);
+				}
+				else if (next_free_chunk_) {
+					done_ += take_n(&next_free_chunk_, nullptr, count_ - done_, out_ + done_);
+				}
+				else {
+					done_ += carve_n(bump_block(), count_ - done_, out_ + done_);
+				}
+			}
+			return done_;
+		}
+
+		/// ------------------------------------------------------------
+		/// DBJ added
+		/// array mode, for the class new[] and delete[]
+		/// array is a run of consecutive never used chunks of one block,
+		/// in front of it is chunky::array_header, thus delete[] knows the
+		/// run length; arrays which do not fit in one block are malloc-ed
+		/// the array is aligned as the chunks are, the header is at the
+		/// end of the first array_offset() bytes of the run
+		/// the run block is found by a scan of all the blocks, see run_block()
+		/// throws std::bad_alloc if the system has no memory for the array
+		void* array_allocate(size_t size_) {
+			const size_t chunks_ = (array_offset() + size_ + chunk_size_.val - 1) / chunk_size_.val;
+			char* run_{};
+
+			if (chunks_ > size_t(chunks_per_block_)) {
+				run_ = heap_aligned::take(array_offset() + size_, alignment_.val);
+				// operator new[] must not return null
+				if (run_ == nullptr) throw std::bad_alloc();
+				return array_start(run_, 0, size_);
+			}
+
+			chunky::block_descriptor& block_ = run_block(chunks_);
+			run_ = block_.bump;
+			block_.bump += chunks_ * chunk_size_.val;
+			for (size_t j = 0; j < chunks_; ++j)
+				mark_in_use(block_, (Chunk*)(run_ + j * chunk_size_.val));
+			if (block_.live == 0) --empty_blocks_;
+			block_.live += chunks_;
+
+			return array_start(run_, chunks_, size_);
+		}
+
+		/// DBJ added
+		/// the last run carved is given back to its block as never used
+		/// chunks of the others go to the free list, as single chunks
+		void array_deallocate(void* array_) {
+			if (array_ == nullptr) return;
+			chunky::array_header* header_ = (chunky::array_header*)array_ - 1;
+			char* const run_ = (char*)array_ - array_offset();
+
+			if (header_->chunks == 0) {
+				heap_aligned::give_back(run_, alignment_.val);
+				return;
+			}
+
+			const size_t chunks_ = header_->chunks;
+			chunky::block_descriptor* block_ = block_registry_.find(run_);
+			_ASSERTE(block_ && block_->live >= chunks_);
+
+			for (size_t j = 0; j < chunks_; ++j)
+				mark_free(*block_, (Chunk*)(run_ + j * chunk_size_.val));
+
+			if (run_ + chunks_ * chunk_size_.val == block_->bump) {
+				block_->bump = run_;
+			}
+			else {
+				// backwards, thus the free list is in the address order
+				for (size_t j = chunks_; j > 0; --j)
+					push_free(*block_, (Chunk*)(run_ + (j - 1) * chunk_size_.val));
+			}
+
+			freed_since_sweep_ += chunks_;
+			block_->live -= chunks_;
+			if (block_->live == 0) {
+				if (++empty_blocks_ > sweep_policy_.high_water)
+					policy_sweep();
+			}
+		}
+
+		/// DBJ added
+		/// chunks are linked in one pass, the sweep policy is checked once
+		void deallocate_n(void** chunks_, size_t count_) {
+			for (size_t j = 0; j < count_; ++j) {
+				Chunk* chunk = chunky::chunk_from_data(chunks_[j]);
+				chunky::block_descriptor* block_ = block_registry_.find(chunk);
+				_ASSERTE(block_ && block_->live > 0);
+				mark_free(*block_, chunk);
+				push_free(*block_, chunk);
+				if (--block_->live == 0) ++empty_blocks_;
+			}
+			freed_since_sweep_ += count_;
+			if (empty_blocks_ > sweep_policy_.high_water)
+				policy_sweep();
 		}
 
-#if 0
+		/// DBJ added
+		/// blocks with no chunk in use
+		size_t empty_block_count() const noexcept { return empty_blocks_; }
+
 		/// ------------------------------------------------------------
 		/// DBJ added
-		/// remove all blocks with all chunk's
-		/// chunk->next NOT pointing to null
-		/// this is potentially expensive operation
-		/// with speculative usefulness
-		/// users have a choice of not calling it
-		void sweep_blocks() const noexcept {
-			// 1. remove all free blocks
-			// 2. do free list rewiring
+		/// give the blocks with no chunk in use back to the system,
+		/// keep_ of them are kept, returns the number of blocks freed
+		/// the free list is rebuilt without the chunks of the blocks freed
+		/// free_list_policy::lifo that is one block lookup per free chunk
+		/// of the pool, per_block has no pool free list to walk
+		/// nothing is allocated, the registry is compacted in place
+		size_t sweep_blocks(size_t keep_ = 0) noexcept {
+			if (empty_blocks_ <= keep_) return 0;
+
+			// 1. mark the empty blocks to be freed
+			size_t kept_{};
+			block_registry_.for_each_descriptor([&](chunky::block_descriptor& block_) {
+				block_.to_release = block_.live == 0 && kept_++ >= keep_;
+			});
+
+			// 2. do free list rewiring, the order is kept
+			unlink_marked();
+
+			// 3. remove the blocks, with their own free lists if any
+			const size_t removed_ = block_registry_.remove_if(
+				[](chunky::block_descriptor const& block_) { return block_.to_release; });
+			empty_blocks_ -= removed_;
+			// descriptors have moved
+			current_block_ = nullptr;
+			bump_block_ = nullptr;
+
+			// 4. pages of the empty blocks kept are given back, the blocks
+			// are carved again from the start, their contents are not needed
+			if (block_registry_.source().is_mapped()) {
+				reclaim_empty_blocks();
+				block_registry_.for_each_descriptor([&](chunky::block_descriptor& block_) {
+					if (block_.live == 0) block_registry_.source().decommit(block_.start, block_.size);
+				});
+			}
+			return removed_;
+		}
+
+		void set_sweep_policy(sweep_policy policy_) noexcept {
+			_ASSERTE(policy_.low_water <= policy_.high_water);
+			sweep_policy_ = policy_;
 		}
-#endif // 0
 
 	private:
 
+		/// DBJ added
+		/// more than high_water empty blocks, the sweep_policy asks for a sweep
+		/// lifo: not before as many chunks are freed as the last free list walk
+		/// has left on it, thus the walk is paid by those deallocations and
+		/// each costs an amortized O(1) block lookups more, not O(free chunks)
+		void policy_sweep() noexcept {
+			if (!free_list_walk_paid()) return;
+			sweep_blocks(sweep_policy_.low_water);
+		}
+
+		/// DBJ added
+		/// per_block has no pool free list, its walk costs nothing
+		bool free_list_walk_paid() const noexcept {
+			return free_list_policy_ == free_list_policy::per_block || freed_since_sweep_ >= sweep_debt_;
+		}
+
+		/// DBJ added
+		/// bytes of the run in front of the array, the header is at their end
+		size_t array_offset() const noexcept {
+			return alignment_.val > sizeof(chunky::array_header) ? alignment_.val : sizeof(chunky::array_header);
+		}
+
+		/// DBJ added
+		void* array_start(char* run_, size_t chunks_, size_t size_) const noexcept {
+			char* const array_ = run_ + array_offset();
+			*((chunky::array_header*)array_ - 1) = { chunks_, size_ };
+			return array_;
+		}
+
+		/// DBJ added
+		void mark_in_use(chunky::block_descriptor& block_, Chunk* chunk_) noexcept {
+#ifdef DBJ_POOL_VALIDATION
+			chunky::in_use_bit bit_ = chunky::in_use_of(block_, chunk_, chunk_size_.val);
+			_ASSERTE(false == bit_.get());
+			bit_.set(true);
+#else
+			(void)block_; (void)chunk_;
+#endif // DBJ_POOL_VALIDATION
+		}
+
+		/// DBJ added
+		void mark_free(chunky::block_descriptor& block_, Chunk* chunk_) noexcept {
+#ifdef DBJ_POOL_VALIDATION
+			// used chunk must have been marked as such
+			chunky::in_use_bit bit_ = chunky::in_use_of(block_, chunk_, chunk_size_.val);
+			_ASSERTE(true == bit_.get());
+			bit_.set(false);
+#else
+			(void)block_; (void)chunk_;
+#endif // DBJ_POOL_VALIDATION
+		}
+
+		/**
+		 * Puts the chunk into the front of the chunks list.
+		 */
+		void push_free(chunky::block_descriptor& block_, Chunk* chunk) noexcept {
+			if (free_list_policy_ == free_list_policy::per_block) {
+				// DBJ added
+				// into the front of the block own list
+				chunk->next = (Chunk*)block_.free_list;
+				block_.free_list = chunk;
+			}
+			else {
+				// The freed chunk's next pointer points to the
+				// current allocation pointer:
+				chunk->next = next_free_chunk_;
+				// And the allocation pointer is moved backwards, and
+				// is set to the returned (now free) chunk:
+				next_free_chunk_ = chunk;
+			}
+		}
+
+		/// DBJ added
+		/// a new block, its chunks are carved on demand
+		chunky::block_descriptor& new_block() {
+			char* const start_ = chunky::allocateRawBlock(
+				this->chunks_per_block_, this->chunk_size_, this->block_registry_);
+			++empty_blocks_;
+			chunky::block_descriptor* block_ = block_registry_.find(start_);
+			_ASSERTE(block_);
+			return *block_;
+		}
+
+		/// DBJ added
+		/// free_list_policy::lifo carves from this one, when it runs out
+		/// from the lowest block not carved out, then from a new block
+		chunky::block_descriptor& bump_block() {
+			if (bump_block_ == nullptr || bump_block_->carved_out()) {
+				bump_block_ = nullptr;
+				block_registry_.for_each_by_address([&](chunky::block_descriptor& block_) {
+					if (!bump_block_ && !block_.carved_out()) bump_block_ = &block_;
+				});
+				if (bump_block_ == nullptr)
+					bump_block_ = &new_block();
+			}
+			return *bump_block_;
+		}
+
+		/// DBJ added
+		/// chunks of the blocks marked to_release are taken off the pool
+		/// free list, one block lookup per free chunk
+		/// the number of chunks left on the list is the next walk debt
+		void unlink_marked() noexcept {
+			size_t left_{};
+			Chunk** link_ = &next_free_chunk_;
+			while (*link_) {
+				chunky::block_descriptor* block_ = block_registry_.find(*link_);
+				_ASSERTE(block_);
+				if (block_->to_release)
+					*link_ = (*link_)->next;
+				else {
+					link_ = &(*link_)->next;
+					++left_;
+				}
+			}
+			sweep_debt_ = left_;
+			freed_since_sweep_ = 0;
+		}
+
+		/// DBJ added
+		/// empty blocks are made never used again, thus runs can be carved from them
+		/// the block is kept, unlike in sweep_blocks()
+		void reclaim_empty_blocks() noexcept {
+			block_registry_.for_each_descriptor([&](chunky::block_descriptor& block_) {
+				block_.to_release = block_.live == 0 && block_.bump != block_.start;
+			});
+			unlink_marked();
+			block_registry_.for_each_descriptor([&](chunky::block_descriptor& block_) {
+				if (!block_.to_release) return;
+				block_.to_release = false;
+				block_.free_list = nullptr;
+				block_.bump = block_.start;
+			});
+		}
+
+		/// DBJ added
+		/// the lowest block with at least chunks_ never used chunks
+		/// if there is none, empty blocks are reclaimed, then a new one is made
+		/// O(blocks) scan for each array; reclaiming walks the lifo free list
+		/// thus on a miss it is done only when that walk has been paid for,
+		/// as the policy sweep is, else a new block is made
+		chunky::block_descriptor& run_block(size_t chunks_) {
+			const size_t bytes_ = chunks_ * chunk_size_.val;
+			auto lowest_fitting = [&] {
+				chunky::block_descriptor* found_{};
+				block_registry_.for_each_by_address([&](chunky::block_descriptor& block_) {
+					if (!found_ && block_.uncarved() >= bytes_) found_ = &block_;
+				});
+				return found_;
+			};
+
+			chunky::block_descriptor* found_ = lowest_fitting();
+			if (found_ == nullptr && empty_blocks_ > 0 && free_list_walk_paid()) {
+				reclaim_empty_blocks();
+				found_ = lowest_fitting();
+			}
+			return found_ ? *found_ : new_block();
+		}
+
+		/// DBJ added
+		/// up to count_ chunks of the list into out_, returns how many
+		/// block_ is the block of them all, null if they are from many
+		size_t take_n(Chunk** list_, chunky::block_descriptor* block_, size_t count_, void** out_) {
+			size_t taken_{};
+			while (taken_ < count_ && *list_) {
+				Chunk* chunk_ = *list_;
+				*list_ = chunk_->next;
+				chunky::block_descriptor* of_ = block_ ? block_ : block_registry_.find(chunk_);
+				_ASSERTE(of_);
+				if (of_->live++ == 0) --empty_blocks_;
+				mark_in_use(*of_, chunk_);
+				out_[taken_++] = chunk_;
+			}
+			return taken_;
+		}
+
+		/// DBJ added
+		/// up to count_ never used chunks of the block into out_, returns how many
+		size_t carve_n(chunky::block_descriptor& block_, size_t count_, void** out_) {
+			size_t taken_{};
+			while (taken_ < count_) {
+				Chunk* chunk_ = chunky::carveChunk(block_, chunk_size_.val);
+				if (!chunk_) break;
+				mark_in_use(block_, chunk_);
+				out_[taken_++] = chunk_;
+			}
+			if (taken_ && block_.live == 0) --empty_blocks_;
+			block_.live += taken_;
+			return taken_;
+		}
+
+		/// DBJ added
+		/// has a free or a never used chunk
+		static bool has_room(chunky::block_descriptor const& block_) noexcept {
+			return block_.free_list || !block_.carved_out();
+		}
+
+		/// DBJ added
+		/// the fullest block which is not full, the lowest address of those
+		/// null if all are full; a scan, made when the current block runs out
+		chunky::block_descriptor* select_block() noexcept {
+			chunky::block_descriptor* best_{};
+			block_registry_.for_each_by_address([&](chunky::block_descriptor& block_) {
+				if (has_room(block_) && (!best_ || block_.live > best_->live))
+					best_ = &block_;
+			});
+			return best_;
+		}
+
+		/// DBJ added
+		/// free_list_policy::per_block allocates from this one
+		chunky::block_descriptor& allocation_block() {
+			if (current_block_ == nullptr || !has_room(*current_block_))
+				current_block_ = select_block();
+			if (current_block_ == nullptr)
+				current_block_ = &new_block();
+			return *current_block_;
+		}
+
+		/// DBJ added
+		/// free_list_policy::per_block
+		/// freed chunks of the block first, then the never used ones
+		void* allocate_from_blocks() {
+			chunky::block_descriptor& block_ = allocation_block();
+
+			Chunk* allocated_chunk = (Chunk*)block_.free_list;
+			if (allocated_chunk)
+				block_.free_list = allocated_chunk->next;
+			else
+				allocated_chunk = chunky::carveChunk(block_, chunk_size_.val);
+			_ASSERTE(allocated_chunk);
+			if (block_.live++ == 0) --empty_blocks_;
+
+			mark_in_use(block_, allocated_chunk);
+			return allocated_chunk;
+		}
+
 		/**
 		 * Number of chunks per larger block.
 		 DBJ made it const
@@ -356,6 +996,21 @@ namespace dbj::shohnikov {
 		 * Allocation pointer.
 		 */
 		Chunk* next_free_chunk_{ nullptr };
+		/*
+		DBJ added
+		*/
+		const chunk_alignment alignment_{};
+		size_t empty_blocks_{ 0 };
+		sweep_policy sweep_policy_{};
+		const free_list_policy free_list_policy_{};
+		/// chunks freed since the last free list walk, and the list length it has left
+		size_t freed_since_sweep_{ 0 };
+		size_t sweep_debt_{ 0 };
+		/// free_list_policy::per_block allocates from this one
+		chunky::block_descriptor* current_block_{ nullptr };
+		/// free_list_policy::lifo carves from this one, the others may have
+		/// never used chunks too, left by the array runs
+		chunky::block_descriptor* bump_block_{ nullptr };
 	}; // dbj_pool_allocators
 	// -----------------------------------------------------------
 } // dbj::shohnikov
@@ -0,0 +1,127 @@
+#ifndef DBJ_STATIC_POOL_INC
+#define DBJ_STATIC_POOL_INC
+/*
+ (c) 2020 by dbj@dbj.org CC BY SA 4.0
+
+ dbj_pool_allocator with its geometry known at compile time.
+
+ Chunk size, alignment and the number of chunks per block are template
+ arguments, thus every stride and block size is a constant. Alignments
+ beyond max_align_t, up to the page size, are fine, the blocks are then
+ taken larger, see heap_aligned in dbj_block_source.h. The fast
+ path of allocate() is a pointer pop from the free list, the slow one
+ a pointer bump through the never used chunks of the newest block.
+
+ Blocks are kept on a list, through a header in front of each, and all
+ freed by the destructor. There is no sweeping, no per block state and
+ no validation, for that use dbj_pool_allocator.
+
+ Not thread safe.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dbj_block_source.h"
+
+namespace dbj::shohnikov {
+
+	/// ALIGNMENT of the chunks, more than alignof(T) for cache line
+	/// isolation, 64, no two chunks share a cache line
+	template<typename T, size_t CHUNKS_PER_BLOCK, size_t ALIGNMENT = alignof(T)>
+	struct static_pool final
+	{
+		static_assert(CHUNKS_PER_BLOCK > 0, "a block of no chunks");
+		static_assert((ALIGNMENT & (ALIGNMENT - 1)) == 0, "alignment must be a power of two");
+
+		/// free chunk is a link in the free list
+		struct chunk final { chunk* next; };
+
+		/// in front of the chunks of each block
+		struct block_header final { block_header* next; };
+
+		constexpr static size_t chunk_alignment =
+			(ALIGNMENT > alignof(T) ? ALIGNMENT : alignof(T)) > alignof(chunk)
+			? (ALIGNMENT > alignof(T) ? ALIGNMENT : alignof(T)) : alignof(chunk);
+
+		static_assert(chunk_alignment <= block_source::page_size,
+			"no more than the page size alignment");
+
+		constexpr static size_t round_up(size_t size_) noexcept {
+			return (size_ + chunk_alignment - 1) & ~(chunk_alignment - 1);
+		}
+
+		constexpr static size_t chunk_size =
+			round_up(sizeof(T) > sizeof(chunk) ? sizeof(T) : sizeof(chunk));
+		constexpr static size_t chunks_per_block = CHUNKS_PER_BLOCK;
+		/// chunks start after it, aligned
+		constexpr static size_t header_size = round_up(sizeof(block_header));
+		constexpr static size_t block_size = header_size + chunks_per_block * chunk_size;
+
+		static_pool() noexcept = default;
+
+		~static_pool() {
+			while (blocks_) {
+				block_header* next_ = blocks_->next;
+				heap_aligned::give_back((char*)blocks_, chunk_alignment);
+				blocks_ = next_;
+			}
+		}
+
+		static_pool(static_pool const&) = delete;
+		static_pool& operator = (static_pool const&) = delete;
+		static_pool(static_pool&&) = delete;
+		static_pool& operator = (static_pool&&) = delete;
+
+		/// freed chunk first, then the next never used one
+		/// null only if the system is out of memory
+		void* allocate() noexcept {
+			if (chunk* chunk_ = free_) {
+				free_ = chunk_->next;
+				return chunk_;
+			}
+			if (bump_ == end_ && !new_block()) return nullptr;
+			void* chunk_ = bump_;
+			bump_ += chunk_size;
+			return chunk_;
+		}
+
+		/// chunk must be from this pool
+		void deallocate(void* chunk_) noexcept {
+			chunk* freed_ = static_cast<chunk*>(chunk_);
+			freed_->next = free_;
+			free_ = freed_;
+		}
+
+		/// blocks taken from the system
+		size_t block_count() const noexcept { return block_count_; }
+
+		/// bytes taken from the system
+		size_t footprint() const noexcept { return block_count_ * block_size; }
+
+	private:
+
+		bool new_block() noexcept {
+			char* const block_ = heap_aligned::take(block_size, chunk_alignment);
+			if (block_ == nullptr) return false;
+			block_header* header_ = reinterpret_cast<block_header*>(block_);
+			header_->next = blocks_;
+			blocks_ = header_;
+			++block_count_;
+			// chunks are carved on demand, see allocate()
+			bump_ = block_ + header_size;
+			end_ = block_ + block_size;
+			return true;
+		}
+
+		chunk* free_{ nullptr };
+		/// never used chunks of the newest block
+		char* bump_{ nullptr };
+		char* end_{ nullptr };
+		block_header* blocks_{ nullptr };
+		size_t block_count_{ 0 };
+	}; // static_pool
+
+} // dbj::shohnikov
+
+#endif // DBJ_STATIC_POOL_INC
@@ -2,6 +2,8 @@
 
 // #include "../dbj--nanolib/dbj++tu.h"
 
+#include <unordered_set>
+
 #include "../dbj--nanolib/vt100win10.h"
 #include "dbj_shoshnikov_pool_allocator.h"
 
@@ -21,12 +23,30 @@ namespace dbj::shohnikov {
 	{
 		using Chunk = dbj_pool_allocator::Chunk;
 
+		/// chunks have no header, free ones are those on the free list
+		using free_chunks = std::unordered_set<Chunk const*>;
+
+		static free_chunks collect_free(dbj_pool_allocator const& pool_)
+		{
+			free_chunks free_{};
+			for (Chunk const* chunk = pool_.next_free_chunk_; chunk; chunk = chunk->next)
+				free_.insert(chunk);
+			// free_list_policy::per_block
+			pool_.block_registry_.for_each_descriptor([&](chunky::block_descriptor const& block_) {
+				for (Chunk const* chunk = (Chunk const*)block_.free_list; chunk; chunk = chunk->next)
+					free_.insert(chunk);
+			});
+			return free_;
+		}
+
 		/// chunk can be in 3.5 states
 		/// - free
 		/// - taken aka "in use"
 		/// - first free to be used aka "next free"; the pool sentinel that is
+		/// - never used, not carved from its block yet
 		/// 
-		static void print_address( Chunk * chunk, dbj_pool_allocator const& pool_ )
+		/// with DBJ_POOL_VALIDATION the in use bit is checked too
+		static void print_address( Chunk * chunk, dbj_pool_allocator const& pool_, free_chunks const & free_ )
 		{
 			if (chunk == nullptr)
 			{
@@ -34,22 +54,35 @@ namespace dbj::shohnikov {
 				return;
 			}
 
+			chunky::block_descriptor const* block_ = pool_.block_registry_.find(chunk);
+			if (block_ && (char const*)chunk >= block_->bump) {
+				// never used, it has no in use bit set nor it is on the free list
+				reporter("| "  DBJFMT " ", chunk);
+				return;
+			}
+
 			Chunk* free_sentinel_ = pool_.next_free_chunk_ ;
+			const bool is_free_ = free_.count(chunk) > 0;
+#ifdef DBJ_POOL_VALIDATION
+			const bool in_use_ = pool_.in_use(chunk);
+#else
+			const bool in_use_ = !is_free_;
+#endif // DBJ_POOL_VALIDATION
 
 			if (chunk == free_sentinel_) {
 				// first free to be used in entire pool
 				reporter(DBJ_FG_YELLOW_BOLD "| "  DBJFMT " " DBJ_RESET, chunk);
-				if ( chunk-> in_use  ) 	reporter(DBJ_FG_RED_BOLD " !in_use == true! " DBJ_RESET);
+				if ( in_use_ ) 	reporter(DBJ_FG_RED_BOLD " !in_use == true! " DBJ_RESET);
 			}
-			else if ((chunk->next) != nullptr) {
+			else if (is_free_) {
 				// part of a free list
 				reporter(DBJ_FG_GREEN "| "  DBJFMT " " DBJ_RESET, chunk);
-				if (chunk->in_use == true )	reporter(DBJ_FG_RED_BOLD " !in_use ==true! " DBJ_RESET);
+				if (in_use_ == true )	reporter(DBJ_FG_RED_BOLD " !in_use ==true! " DBJ_RESET);
 			}
 			else {
 					// in use
 					reporter(DBJ_FG_RED "| " DBJFMT " " DBJ_RESET, chunk);
-					if (chunk->in_use == false)	reporter(DBJ_FG_RED_BOLD " !in_use == false! " DBJ_RESET);
+					if (in_use_ == false)	reporter(DBJ_FG_RED_BOLD " !in_use == false! " DBJ_RESET);
 			}
 		}
 
@@ -71,6 +104,7 @@ namespace dbj::shohnikov {
 
 			auto block_counter = 0U;
 			size_t chunk_allocation_size_ = chunky::chunk_allocation_size(pool_.chunk_size_);
+			const free_chunks free_ = collect_free(pool_);
 
 			auto for_each_chunk = [&] ( char * block_slab_  ) -> void {
 
@@ -80,7 +114,7 @@ namespace dbj::shohnikov {
 					char* chunk_address = (char*)(block_slab_);
 
 					for (size_t i = 0; i < size_t(pool_.chunks_per_block_); ++i) {
-						print_address((Chunk*)chunk_address /*dbj_pool_allocator::chunk_from_data(chunk_address)*/, pool_);
+						print_address((Chunk*)chunk_address, pool_, free_);
 						chunk_address = (char*)(chunk_address + chunk_allocation_size_);
 					}
 			};
@@ -89,7 +123,7 @@ namespace dbj::shohnikov {
 
 			/// footer
 			reporter("\n\n" DBJ_FG_BLUE_BOLD "Next free chunk: " DBJ_RESET);
-			print_address( pool_.next_free_chunk_ , pool_);
+			print_address( pool_.next_free_chunk_ , pool_, free_);
 		}
 		/// ---------------------------------------------------------------------
 
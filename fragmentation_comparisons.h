@@ -0,0 +1,272 @@
+#pragma once
+
+/// ---------------------------------------------------------------------
+/// system allocators are said to be the best against fragmentation
+/// here it is measured
+///
+/// a long running, randomized workload of mixed sizes and mixed lifetimes
+/// RSS and the allocator own stats are sampled periodically, outside
+/// of the timed segments, the overhead ratio is RSS / live bytes
+///
+/// two workloads
+///  - small, 8 .. 256 bytes, the fixed size pools take part too,
+///    chunks of 256 bytes, so their internal fragmentation is measured
+///  - mixed, 16 bytes .. 128 KB, general purpose allocators only
+///
+#define MEM_ALLOC_FRAGMENTATION_COMPARISONS
+#ifdef MEM_ALLOC_FRAGMENTATION_COMPARISONS
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "comparisons.h"
+#include "dbj_benchmarking/process_memory.h"
+
+namespace fragmentation_comparisons {
+
+#ifdef NDEBUG
+	constexpr size_t workload_steps = 0x400000;
+#else
+	constexpr size_t workload_steps = 0x40000;
+#endif // NDEBUG
+
+	/// RSS and stats are sampled every that many steps
+	constexpr size_t sampling_interval = 0x4000;
+	constexpr size_t page_size = 0x1000;
+
+	/// the nvwa fixed pool does not grow, this is well above the
+	/// number of blocks the workload keeps alive
+	constexpr size_t pool_chunks_per_block = 0x4000;
+	/// the live set is kept in a heap, made before the RSS baseline
+	constexpr size_t expected_live_blocks = 0x4000;
+
+	struct workload final {
+		const char* name{};
+		/// sizes are in [min_size, max_size)
+		size_t min_size{};
+		size_t max_size{};
+	};
+
+	constexpr workload small_workload{ "small", 8, 256 };
+	constexpr workload mixed_workload{ "mixed", 16, 128 * 1024 };
+
+	/// the pools which give empty blocks back, smaller blocks to have
+	/// a chance of being empty, more than 4 empty are swept down to 1
+	using sweeping_pool_adapter = allocator_adapters::dbj_pool_adapter<
+		small_workload.max_size, 0x100, 4, 1>;
+	/// chunks allocated from the fullest blocks, the others empty sooner
+	using per_block_sweeping_pool_adapter = allocator_adapters::dbj_pool_adapter<
+		small_workload.max_size, 0x100, 4, 1, dbj::shohnikov::free_list_policy::per_block>;
+	/// the large block, 4 MiB, straight from the OS, on huge pages
+	using huge_page_pool_adapter = allocator_adapters::dbj_pool_adapter<
+		small_workload.max_size, pool_chunks_per_block, SIZE_MAX, 0,
+		dbj::shohnikov::free_list_policy::lifo, true>;
+
+	struct sample final {
+		size_t live_bytes{};
+		size_t rss_growth{};
+		size_t footprint{};
+	};
+
+	struct result final {
+		double seconds{};
+		size_t peak_live_bytes{};
+		size_t peak_rss_growth{};
+		size_t peak_footprint{};
+		size_t blocks{};
+		/// allocate() returned null, the nvwa fixed pool when exhausted
+		size_t failed{};
+		std::vector<sample> samples{};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// sizes: geometric size classes, small ones are more probable
+	/// lifetimes, in steps: 80% die young, 18% live a while, 2% live long
+	/// every lifetime is bounded thus the live set reaches a steady state
+	/// the seed is fixed, each allocator gets the same workload
+	template<typename A>
+	inline result run(A& adapter_, workload const& load_, size_t rss_before_)
+	{
+		using engine = dbj::timing::engine;
+		constexpr bool has_stats_ = dbj::bench::adapter_traits<A>::has_stats;
+
+		struct pending final {
+			uint64_t dies_at{};
+			void* block{};
+			size_t size{};
+			bool operator > (pending const& other_) const noexcept { return dies_at > other_.dies_at; }
+		};
+
+		// made and touched before the baseline is taken
+		std::vector<pending> storage_(expected_live_blocks);
+		storage_.clear();
+		std::priority_queue<pending, std::vector<pending>, std::greater<pending>> live_(
+			std::greater<pending>{}, std::move(storage_));
+
+		result rez_{};
+		rez_.samples.reserve(workload_steps / sampling_interval + 1);
+
+		std::mt19937 rng_(0xDB1);
+		std::geometric_distribution<int> size_class_(0.35);
+		std::uniform_int_distribution<int> percent_(0, 99);
+
+		int max_class_{};
+		while ((load_.min_size << (max_class_ + 1)) < load_.max_size) ++max_class_;
+
+		size_t live_bytes_{};
+		double elapsed_ns_{};
+		auto take_sample = [&] {
+			const size_t rss_ = dbj::process_memory::current_rss();
+			sample s_{ live_bytes_, rss_ > rss_before_ ? rss_ - rss_before_ : 0, 0 };
+			if constexpr (has_stats_) {
+				s_.footprint = adapter_.stats().footprint;
+				rez_.peak_footprint = (std::max)(rez_.peak_footprint, s_.footprint);
+			}
+			rez_.peak_rss_growth = (std::max)(rez_.peak_rss_growth, s_.rss_growth);
+			rez_.samples.push_back(s_);
+		};
+
+		for (size_t step_ = 0; step_ < workload_steps; step_ += sampling_interval) {
+
+			const dbj::timing::tick_type start_ = engine::start();
+			for (size_t j = step_; j < step_ + sampling_interval; ++j) {
+				const int class_ = (std::min)(size_class_(rng_), max_class_);
+				const size_t base_ = load_.min_size << class_;
+				const size_t size_ = base_ + rng_() % base_;
+
+				const int p_ = percent_(rng_);
+				const uint64_t lifetime_ = p_ < 80 ? 1 + rng_() % 64
+					: (p_ < 98 ? 64 + rng_() % 0x1000 : 0x1000 + rng_() % 0x40000);
+
+				char* block_ = (char*)adapter_.allocate(size_, alignof(void*));
+				if (block_) {
+					for (size_t k = 0; k < size_; k += page_size) block_[k] = char(k);
+					live_.push({ j + lifetime_, block_, size_ });
+					live_bytes_ += size_;
+					if (live_bytes_ > rez_.peak_live_bytes) rez_.peak_live_bytes = live_bytes_;
+				}
+				else {
+					++rez_.failed;
+				}
+
+				while (!live_.empty() && live_.top().dies_at <= j) {
+					adapter_.deallocate(live_.top().block, live_.top().size);
+					live_bytes_ -= live_.top().size;
+					live_.pop();
+				}
+			}
+			elapsed_ns_ += engine::elapsed_ns(start_, engine::stop());
+
+			take_sample();
+		}
+
+		if constexpr (has_stats_) rez_.blocks = adapter_.stats().blocks;
+
+		while (!live_.empty()) {
+			adapter_.deallocate(live_.top().block, live_.top().size);
+			live_.pop();
+		}
+
+		rez_.seconds = elapsed_ns_ / 1e9;
+		return rez_;
+	}
+
+	/// ---------------------------------------------------------------------
+	/// steady state is the second half of the run
+	/// the overhead is the mean of the sampled RSS / live bytes ratios
+	inline double steady_overhead(std::vector<sample> const& samples_, size_t sample::* what_)
+	{
+		double sum_{};
+		size_t count_{};
+		for (size_t j = samples_.size() / 2; j < samples_.size(); ++j) {
+			if (samples_[j].live_bytes < 1) continue;
+			sum_ += double(samples_[j].*what_) / double(samples_[j].live_bytes);
+			++count_;
+		}
+		return count_ ? sum_ / double(count_) : 0.0;
+	}
+
+	inline void reporter(const char* name, workload const& load_, result const& rez_, bool has_stats_)
+	{
+		const double peak_overhead_ = rez_.peak_live_bytes
+			? double(rez_.peak_rss_growth) / double(rez_.peak_live_bytes) : 0.0;
+		const double steady_ = steady_overhead(rez_.samples, &sample::rss_growth);
+
+		DBJ_PRINT(DBJ_FG_RED_BOLD "%-22s" DBJ_RESET " %8.3f sec, peak live: %8zu KB, peak RSS growth: %8zu KB, RSS / live -- peak: %6.2f, steady state: %6.2f",
+			name, rez_.seconds, rez_.peak_live_bytes / 1024, rez_.peak_rss_growth / 1024, peak_overhead_, steady_);
+
+		dbj::results::record record_{ std::string("fragmentation_") + load_.name, name, load_.max_size, 1, {},
+			{ { "seconds", rez_.seconds }, { "peak_live_bytes", double(rez_.peak_live_bytes) },
+			  { "peak_rss_growth_bytes", double(rez_.peak_rss_growth) },
+			  { "peak_overhead", peak_overhead_ }, { "steady_overhead", steady_ } } };
+
+		if (has_stats_) {
+			const double footprint_steady_ = steady_overhead(rez_.samples, &sample::footprint);
+			DBJ_PRINT("%-22s allocator footprint -- peak: %zu KB, footprint / live steady state: %6.2f",
+				" ", rez_.peak_footprint / 1024, footprint_steady_);
+			record_.metrics.push_back({ "peak_footprint_bytes", double(rez_.peak_footprint) });
+			record_.metrics.push_back({ "steady_footprint_overhead", footprint_steady_ });
+			// nedmalloc does not tell
+			if (rez_.blocks) {
+				DBJ_PRINT("%-22s blocks taken from the system: %zu", " ", rez_.blocks);
+				record_.metrics.push_back({ "blocks", double(rez_.blocks) });
+			}
+		}
+		if (rez_.failed)
+			DBJ_PRINT("%-22s " DBJ_FG_RED_BOLD "%zu allocations failed" DBJ_RESET, " ", rez_.failed);
+
+		dbj::results::sink().add(std::move(record_));
+	}
+
+	/// the adapter is made after the RSS baseline, pools which take
+	/// their memory on construction are thus measured too
+	template<typename A>
+	inline void specimen(workload const& load_)
+	{
+		dbj::process_memory::trim_system_heap();
+		const size_t rss_before_ = dbj::process_memory::current_rss();
+		A adapter_{};
+		reporter(A::name(), load_, run(adapter_, load_, rss_before_), dbj::bench::adapter_traits<A>::has_stats);
+	}
+
+	/// ---------------------------------------------------------------------
+	/// allocators which can not serve the sizes of the workload are left out
+	inline void compare_fragmentation_mechanisms(workload const& load_)
+	{
+		DBJ_PRINT(" ");
+		DBJ_PRINT(DBJ_FG_BLUE_BOLD "Workload: %s, %zu .. %zu bytes" DBJ_RESET, load_.name, load_.min_size, load_.max_size - 1);
+
+		allocator_adapters::registry<small_workload.max_size, pool_chunks_per_block>::for_each_type(
+			[&](auto tag_) {
+				using A = typename decltype(tag_)::type;
+				if (dbj::bench::adapter_traits<A>::max_size >= load_.max_size)
+					specimen<A>(load_);
+			});
+
+		if (dbj::bench::adapter_traits<sweeping_pool_adapter>::max_size >= load_.max_size) {
+			specimen<sweeping_pool_adapter>(load_);
+			specimen<per_block_sweeping_pool_adapter>(load_);
+			specimen<huge_page_pool_adapter>(load_);
+		}
+	}
+
+	/// ---------------------------------------------------------------------
+	inline void fragmentation_comparator()
+	{
+		DBJ_PRINT(" ");
+		DBJ_PRINT("Fragmentation and footprint, %zu allocations of randomized size and lifetime", workload_steps);
+		DBJ_PRINT("RSS and the allocator stats are sampled every %zu allocations, steady state is the second half of the run", sampling_interval);
+		dbj::timing::warm_up();
+		compare_fragmentation_mechanisms(small_workload);
+		compare_fragmentation_mechanisms(mixed_workload);
+	}
+
+	TUF_REG(fragmentation_comparator);
+
+} // namespace fragmentation_comparisons
+
+#endif // MEM_ALLOC_FRAGMENTATION_COMPARISONS
@@ -15,7 +15,9 @@ extern "C" {
 	inline void* k_memory_()
 	{
 		static void* k_memory_single_ = km_init();
-		/*static int rez =*/ atexit(on_exit_release_kmem_pointer);
+		// registered once, km_destroy called more than once is a double free
+		static int rez = atexit(on_exit_release_kmem_pointer);
+		(void)rez;
 		return k_memory_single_;
 	}
 
@@ -1,6 +1,12 @@
 
 #include "common.h"
 #include "comparisons.h"
+#include "per_op_comparisons.h"
+#include "mt_comparisons.h"
+#include "cross_thread_comparisons.h"
+#include "trace_replay_comparisons.h"
+#include "fragmentation_comparisons.h"
+#include "pmr_comparisons.h"
 
 #ifdef DBJ_PLAYGROUND
 #include "dbj_pool_allocator/pool_allocator_sampling.h"
@@ -16,5 +22,11 @@ int main(int, char**)
 	/// bellow might be executed easy with std::async
 	/// but that would add yet another unknown in the
 	/// already complex benchmarking equation
-	return dbj::tu::testing_system::execute();
+	/// threads are used only inside mt_comparisons.h 
+	/// where they are the subject of the measurement
+	(void)dbj::results::metadata();
+	const int rez_ = dbj::tu::testing_system::execute();
+	/// see dbj_benchmarking/results_sink.h
+	dbj::results::write_results();
+	return rez_;
 }
\ No newline at end of file
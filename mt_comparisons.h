@@ -0,0 +1,166 @@
+#pragma once
+
+/// ---------------------------------------------------------------------
+/// all the other comparisons are single threaded
+/// here each allocator is hammered from 1 .. N threads at once
+/// aggregate throughput and the scaling efficiency are reported
+/// per thread count, to see where each one collapses under contention
+///
+#define MEM_ALLOC_MT_COMPARISONS
+#ifdef MEM_ALLOC_MT_COMPARISONS
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "comparisons.h"
+
+namespace mt_comparisons {
+
+	/// fixed size pools are instantiated for this size
+	constexpr size_t object_size = 64, batch_size = 0x40;
+#ifdef NDEBUG
+	constexpr size_t batches_per_thread = 0x4000;
+#else
+	constexpr size_t batches_per_thread = 0x400;
+#endif // NDEBUG
+	/// the best of the lot is reported
+	constexpr int test_loop_size = 3;
+
+	/// 1, 2, 4 ... up to the number of hardware threads, that one included
+#ifndef DBJ_MT_MAX_THREADS
+#define DBJ_MT_MAX_THREADS 64
+#endif // DBJ_MT_MAX_THREADS
+
+	inline std::vector<unsigned> thread_counts() {
+		unsigned max_ = std::thread::hardware_concurrency();
+		if (max_ < 2) max_ = 2;
+		if (max_ > DBJ_MT_MAX_THREADS) max_ = DBJ_MT_MAX_THREADS;
+
+		std::vector<unsigned> counts_;
+		for (unsigned j = 1; j < max_; j *= 2) counts_.push_back(j);
+		counts_.push_back(max_);
+		return counts_;
+	}
+
+	/// the nvwa fixed pool does not grow, it has to hold
+	/// the batches of all the threads at once
+	constexpr size_t pool_chunks_per_block = 0x1000;
+	static_assert(DBJ_MT_MAX_THREADS * batch_size <= pool_chunks_per_block);
+
+	/// ---------------------------------------------------------------------
+	/// all threads are created and waiting before the clock starts
+	/// each allocates batch_size objects, touches them, frees them
+	/// returns the wall time in nanoseconds
+	template<typename ALOKA, typename DEALOKA>
+	inline double run_threads(unsigned thread_count_, ALOKA aloka, DEALOKA dealoka)
+	{
+		std::atomic<unsigned> ready_{ 0 };
+		std::atomic<bool> go_{ false };
+		std::vector<std::thread> threads_;
+		threads_.reserve(thread_count_);
+
+		for (unsigned j = 0; j < thread_count_; ++j)
+			threads_.emplace_back([&] {
+			void* ptrs_[batch_size]{};
+			ready_.fetch_add(1);
+			while (!go_.load(std::memory_order_acquire)) std::this_thread::yield();
+
+			for (size_t b_ = 0; b_ < batches_per_thread; ++b_) {
+				for (auto& p_ : ptrs_) {
+					p_ = aloka();
+					*(char*)p_ = char(b_);
+				}
+				for (auto& p_ : ptrs_) dealoka(p_);
+			}
+		});
+
+		while (ready_.load() < thread_count_) std::this_thread::yield();
+
+		const dbj::timing::tick_type start_ = dbj::timing::engine::start();
+		go_.store(true, std::memory_order_release);
+		for (auto& t_ : threads_) t_.join();
+		const dbj::timing::tick_type stop_ = dbj::timing::engine::stop();
+
+		return dbj::timing::engine::elapsed_ns(start_, stop_);
+	}
+
+	/// ---------------------------------------------------------------------
+	/// the latency is the wall time of one run
+	inline void reporter(const char* name, unsigned thread_count_, dbj::latency::summary const& sum_,
+		double ops_per_sec_, double efficiency_) {
+		DBJ_PRINT(DBJ_FG_RED_BOLD "%-28s" DBJ_RESET " threads: %3u, Mops/sec: %10.2f, scaling efficiency: %6.1f%%",
+			name, thread_count_, ops_per_sec_ / 1e6, 100 * efficiency_);
+
+		dbj::results::sink().add({ "multithreaded", name, object_size, thread_count_, sum_,
+			{ { "mops_per_sec", ops_per_sec_ / 1e6 }, { "scaling_efficiency", efficiency_ } } });
+	}
+
+	/// scaling efficiency is throughput(N) / ( N * throughput(1) )
+	template<typename A>
+	inline void specimen(A& adapter_)
+	{
+		const char* name_ = adapter_.name();
+		auto aloka = [&] { return adapter_.allocate(object_size, alignof(void*)); };
+		auto dealoka = [&](void* p_) { adapter_.deallocate(p_, object_size); };
+
+		double single_thread_ops_{};
+		for (unsigned thread_count_ : thread_counts()) {
+			dbj::collector coll_(name_);
+			DBJ_REPEAT(test_loop_size) {
+				coll_.add(run_threads(thread_count_, aloka, dealoka));
+			}
+			// allocation and deallocation are two operations
+			const double ops_ = 2.0 * batch_size * batches_per_thread * thread_count_;
+			const dbj::latency::summary sum_ = coll_.summary();
+			const double ops_per_sec_ = ops_ / (sum_.min / 1e9);
+			if (thread_count_ == 1) single_thread_ops_ = ops_per_sec_;
+			reporter(name_, thread_count_, sum_, ops_per_sec_, ops_per_sec_ / (thread_count_ * single_thread_ops_));
+		}
+		DBJ_PRINT(" ");
+	}
+
+	/// ---------------------------------------------------------------------
+	/// allocators which are not thread safe are shared behind a mutex
+	/// and, the road map in the architecture.md, used one instance per thread
+	inline void compare_mt_mechanisms()
+	{
+		allocator_adapters::registry<object_size, pool_chunks_per_block>::for_each(
+			[](auto& adapter_) {
+				using A = std::decay_t<decltype(adapter_)>;
+				using traits = dbj::bench::adapter_traits<A>;
+
+				if constexpr (traits::thread_safe) {
+					specimen(adapter_);
+				}
+				else {
+					dbj::bench::locked_adapter<A> locked_(adapter_);
+					specimen(locked_);
+
+					if constexpr (!traits::singleton) {
+						dbj::bench::per_thread_adapter<A> per_thread_{};
+						specimen(per_thread_);
+					}
+				}
+			});
+	}
+
+	/// ---------------------------------------------------------------------
+	inline void mt_comparator()
+	{
+		DBJ_PRINT(" ");
+		DBJ_PRINT("Multithreaded allocation, %zu bytes objects", object_size);
+		DBJ_PRINT("Each thread does %zu batches of %zu allocations followed by %zu deallocations",
+			batches_per_thread, batch_size, batch_size);
+		DBJ_PRINT("Hardware threads: %u, best of %d runs is reported", std::thread::hardware_concurrency(), test_loop_size);
+		DBJ_PRINT(" ");
+		dbj::timing::warm_up();
+		compare_mt_mechanisms();
+	}
+
+	TUF_REG(mt_comparator);
+
+} // namespace mt_comparisons
+
+#endif // MEM_ALLOC_MT_COMPARISONS
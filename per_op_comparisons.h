@@ -0,0 +1,127 @@
+#pragma once
+
+/// ---------------------------------------------------------------------
+/// comparisons.h times the whole batch: one huge array allocated, filled
+/// with rand() and freed. That is dominated by page faults and rand().
+/// Here individual allocate()/deallocate() calls are timed, for small
+/// fixed sizes, in tight loops, against the same specimens.
+///
+#define MEM_ALLOC_PER_OP_COMPARISONS
+#ifdef MEM_ALLOC_PER_OP_COMPARISONS
+
+#include "comparisons.h"
+
+namespace per_op_comparisons {
+
+	/// one timestamp pair per batch, thus the timer overhead
+	/// and resolution are spread over batch_size operations
+	/// batch_size pointers are kept on the stack
+	constexpr size_t batch_size = 0x40, batch_count = 0x400;
+
+	/// ---------------------------------------------------------------------
+	/// times batch_size allocations, then batch_size deallocations
+	/// the per operation time is the batch time divided by batch_size
+	/// counters are taken around each batch, outside of the timestamps
+	template<typename ALOKA, typename DEALOKA>
+	inline void driver(dbj::collector& alloc_coll_, dbj::collector& dealloc_coll_,
+		ALOKA aloka, DEALOKA dealoka)
+	{
+		using engine = dbj::timing::engine;
+		dbj::perf::counter_group& counters_ = dbj::perf::counters();
+		dbj::timing::warm_up();
+
+		void* ptrs_[batch_size]{};
+
+		// not timed, pools make their first block here
+		for (auto& p_ : ptrs_) p_ = aloka();
+		for (auto& p_ : ptrs_) dealoka(p_);
+
+		DBJ_REPEAT(batch_count) {
+			counters_.start();
+			dbj::timing::tick_type start_ = engine::start();
+			for (auto& p_ : ptrs_) p_ = aloka();
+			dbj::timing::tick_type stop_ = engine::stop();
+			alloc_coll_.add_counters(counters_.stop(), batch_size);
+			alloc_coll_.add(engine::elapsed_ns(start_, stop_) / batch_size);
+
+			dbj::timing::do_not_optimize(ptrs_);
+
+			counters_.start();
+			start_ = engine::start();
+			for (auto& p_ : ptrs_) dealoka(p_);
+			stop_ = engine::stop();
+			dealloc_coll_.add_counters(counters_.stop(), batch_size);
+			dealloc_coll_.add(engine::elapsed_ns(start_, stop_) / batch_size);
+		}
+	}
+
+	/// ---------------------------------------------------------------------
+	inline void reporter(const char* name, size_t size_, dbj::collector const& alloc_coll_, dbj::collector const& dealloc_coll_) {
+		using dbj::latency::to_text;
+		const dbj::latency::summary alloc_ = alloc_coll_.summary();
+		const dbj::latency::summary dealloc_ = dealloc_coll_.summary();
+
+		DBJ_PRINT(DBJ_FG_RED_BOLD "%-22s" DBJ_RESET " allocate   mean: %s, p50: %s, p99: %s, p99.9: %s",
+			name, to_text(alloc_.mean).text, to_text(alloc_.p50).text, to_text(alloc_.p99).text, to_text(alloc_.p999).text);
+		dbj::print_counters(alloc_coll_.counters_, "                       allocate   ");
+		DBJ_PRINT("%-22s deallocate mean: %s, p50: %s, p99: %s, p99.9: %s",
+			" ", to_text(dealloc_.mean).text, to_text(dealloc_.p50).text, to_text(dealloc_.p99).text, to_text(dealloc_.p999).text);
+		dbj::print_counters(dealloc_coll_.counters_, "                       deallocate ");
+
+		dbj::results::sink().add({ "per_op_allocate", name, size_, 1, alloc_, dbj::counter_metrics(alloc_coll_.counters_) });
+		dbj::results::sink().add({ "per_op_deallocate", name, size_, 1, dealloc_, dbj::counter_metrics(dealloc_coll_.counters_) });
+	}
+
+	template<typename A>
+	inline void specimen(A& adapter_, size_t size_) {
+		dbj::collector coll_alloc(adapter_.name());
+		dbj::collector coll_dealloc(adapter_.name());
+		driver(coll_alloc, coll_dealloc,
+			[&] { return adapter_.allocate(size_, alignof(void*)); },
+			[&](void* p_) { adapter_.deallocate(p_, size_); }
+		);
+		reporter(adapter_.name(), size_, coll_alloc, coll_dealloc);
+	}
+
+	/// ---------------------------------------------------------------------
+	/// all the registered allocators, fixed size pools are made for N
+	/// one block of batch_size chunks, the pools never need a second one
+	template<size_t N>
+	inline void compare_at_size() {
+
+		static_assert(N >= sizeof(void*), "free lists are kept inside the chunks");
+
+		DBJ_PRINT(" ");
+		DBJ_PRINT(DBJ_FG_BLUE_BOLD "Object size: %zu bytes" DBJ_RESET, N);
+
+		allocator_adapters::registry<N, batch_size>::for_each(
+			[](auto& adapter_) { specimen(adapter_, N); });
+	}
+
+	/// ---------------------------------------------------------------------
+	inline void per_op_comparator()
+	{
+		DBJ_PRINT(" ");
+		DBJ_PRINT("Per operation latency of allocate() and deallocate()");
+		DBJ_PRINT("Timestamp taken once per %zu operations, %zu batches per specimen", batch_size, batch_count);
+		dbj::timing::warm_up();
+		DBJ_PRINT("Timing with %s, start/stop overhead of %.1f ns is subtracted from each batch",
+			dbj::timing::engine::name, dbj::timing::engine::overhead_ns());
+
+		compare_at_size<8>();
+		compare_at_size<16>();
+		compare_at_size<32>();
+		compare_at_size<64>();
+		compare_at_size<128>();
+		compare_at_size<256>();
+		compare_at_size<512>();
+		compare_at_size<1024>();
+		compare_at_size<2048>();
+		compare_at_size<4096>();
+	}
+
+	TUF_REG(per_op_comparator);
+
+} // namespace per_op_comparisons
+
+#endif // MEM_ALLOC_PER_OP_COMPARISONS
@@ -0,0 +1,186 @@
+#pragma once
+
+/// ---------------------------------------------------------------------
+/// the allocators as std::pmr::memory_resource, behind the std containers
+/// see dbj_benchmarking/adapter_resource.h
+///
+/// that is how they would be used in production, no operator new of
+/// the classes overloaded, the container is given the resource
+///
+/// three workloads, each on each resource
+///  - vector, push_back, one growing array, the fixed size pools serve
+///    its first few capacities only, the rest is from the upstream
+///  - unordered_map, insert, find, erase, nodes and the buckets array
+///  - list, push_back, remove_if, push_front, nodes only
+///
+/// fixed size pools are made for nodes of up to node_size bytes,
+/// larger allocations go to the upstream, std::pmr::new_delete_resource()
+/// their count is reported
+///
+#define MEM_ALLOC_PMR_COMPARISONS
+#ifdef MEM_ALLOC_PMR_COMPARISONS
+
+#include <list>
+#include <memory_resource>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "comparisons.h"
+#include "dbj_benchmarking/adapter_resource.h"
+
+namespace pmr_comparisons {
+
+	/// kfree() walks the kalloc free list, freeing the nodes one by one
+	/// is quadratic in their number, thus not more
+#ifdef NDEBUG
+	constexpr size_t element_count = 0x10000;
+#else
+	constexpr size_t element_count = 0x4000;
+#endif // NDEBUG
+	constexpr int test_loop_size = 0xF;
+
+	/// list and unordered_map nodes of uint64_t are 24 .. 32 bytes
+	constexpr size_t node_size = 64;
+	constexpr size_t chunks_per_block = 0x400;
+	/// the nvwa fixed pool does not grow, the list holds
+	/// one and a half element_count nodes at most
+	constexpr size_t nvwa_fixed_chunks = 2 * element_count;
+
+	using registry = dbj::bench::allocator_registry<
+#ifdef DBJ_KMEM_SAMPLING
+		allocator_adapters::kmem_adapter,
+#endif // DBJ_KMEM_SAMPLING
+		allocator_adapters::nvwa_static_adapter<node_size>,
+		allocator_adapters::nvwa_fixed_adapter<node_size, nvwa_fixed_chunks>,
+		allocator_adapters::dbj_pool_adapter<node_size, chunks_per_block>,
+		allocator_adapters::dbj_pools_adapter,
+		allocator_adapters::ned_pool_adapter,
+		allocator_adapters::malloc_adapter
+	>;
+
+	/// ---------------------------------------------------------------------
+	inline void vector_workload(std::pmr::memory_resource* resource_)
+	{
+		std::pmr::vector<uint64_t> vector_(resource_);
+		for (size_t j = 0; j < element_count; ++j)
+			vector_.push_back(j);
+		dbj::timing::do_not_optimize(vector_.data());
+	}
+
+	/// keys are random, the seed is fixed, the same keys each time
+	inline void unordered_map_workload(std::pmr::memory_resource* resource_)
+	{
+		std::pmr::unordered_map<uint64_t, uint64_t> map_(resource_);
+		std::mt19937_64 rng_(0xDB1);
+		for (size_t j = 0; j < element_count; ++j)
+			map_.emplace(rng_(), j);
+
+		rng_.seed(0xDB1);
+		uint64_t found_{};
+		for (size_t j = 0; j < element_count; ++j)
+			found_ += map_.count(rng_());
+		dbj::timing::do_not_optimize(found_);
+
+		for (auto it_ = map_.begin(); it_ != map_.end(); )
+			it_ = (it_->first & 1) ? map_.erase(it_) : std::next(it_);
+	}
+
+	/// half of the nodes freed, in the middle of the list, then more made
+	inline void list_workload(std::pmr::memory_resource* resource_)
+	{
+		std::pmr::list<uint64_t> list_(resource_);
+		for (size_t j = 0; j < element_count; ++j)
+			list_.push_back(j);
+		list_.remove_if([](uint64_t v_) { return v_ & 1; });
+		for (size_t j = 0; j < element_count; ++j)
+			list_.push_front(j);
+		dbj::timing::do_not_optimize(list_.front());
+	}
+
+	struct workload final {
+		const char* name{};
+		void (*run)(std::pmr::memory_resource*) {};
+	};
+
+	constexpr workload workloads[]{
+		{ "vector", vector_workload },
+		{ "unordered_map", unordered_map_workload },
+		{ "list", list_workload }
+	};
+
+	/// ---------------------------------------------------------------------
+	/// counters are per one element
+	inline void reporter(const char* name, workload const& load_, dbj::collector const& collector_, size_t upstream_count_)
+	{
+		const dbj::latency::summary sum_ = collector_.summary();
+		DBJ_PRINT(DBJ_FG_RED_BOLD "%-26s" DBJ_RESET " has been tested %3d times, %zu elements",
+			name, int(sum_.count), element_count);
+		dbj::print_summary(sum_);
+		dbj::print_counters(collector_.counters_);
+		if (upstream_count_)
+			DBJ_PRINT("%zu allocations per run served by the upstream resource", upstream_count_);
+
+		dbj::results::record record_{ std::string("pmr_") + load_.name, name, element_count, 1, sum_,
+			dbj::counter_metrics(collector_.counters_) };
+		record_.metrics.push_back({ "upstream_allocations", double(upstream_count_) });
+		dbj::results::sink().add(std::move(record_));
+	}
+
+	inline void measure(dbj::collector& collector_, std::pmr::memory_resource& resource_, workload const& load_)
+	{
+		DBJ_REPEAT(test_loop_size) {
+			dbj::driver(collector_, [&] { load_.run(&resource_); }, element_count);
+		}
+	}
+
+	/// each specimen is made for the workload, thus starts empty
+	template<typename A>
+	inline void specimen(workload const& load_)
+	{
+		dbj::bench::adapter_resource<A> resource_{};
+		dbj::collector collector_(resource_.name());
+		measure(collector_, resource_, load_);
+		reporter(resource_.name(), load_, collector_, resource_.upstream_count() / test_loop_size);
+	}
+
+	/// ---------------------------------------------------------------------
+	/// the std resources are the baseline
+	inline void compare_resources(workload const& load_)
+	{
+		DBJ_PRINT(" ");
+		DBJ_PRINT(DBJ_FG_BLUE_BOLD "Workload: std::pmr::%s" DBJ_RESET, load_.name);
+
+		registry::for_each_type([&](auto tag_) {
+			specimen<typename decltype(tag_)::type>(load_);
+			});
+
+		{
+			std::pmr::unsynchronized_pool_resource resource_{};
+			dbj::collector collector_("unsynchronized_pool_resource");
+			measure(collector_, resource_, load_);
+			reporter(collector_.name_, load_, collector_, 0);
+		}
+		{
+			dbj::collector collector_("new_delete_resource");
+			measure(collector_, *std::pmr::new_delete_resource(), load_);
+			reporter(collector_.name_, load_, collector_, 0);
+		}
+	}
+
+	/// ---------------------------------------------------------------------
+	inline void pmr_comparator()
+	{
+		DBJ_PRINT(" ");
+		DBJ_PRINT("The allocators as std::pmr::memory_resource, %zu elements, fixed size pools made for %zu bytes",
+			element_count, node_size);
+		dbj::timing::warm_up();
+		for (workload const& load_ : workloads)
+			compare_resources(load_);
+	}
+
+	TUF_REG(pmr_comparator);
+
+} // namespace pmr_comparisons
+
+#endif // MEM_ALLOC_PMR_COMPARISONS
@@ -1,11 +1,21 @@
 #ifndef SHOSHNIKOV_POOL_ALLOCATOR_INC
 #define SHOSHNIKOV_POOL_ALLOCATOR_INC
 
+#include <algorithm>
+#include <vector>
+
+// DBJ added
+// allocate(size) checks the size is not larger than the chunk size
+// by default in debug builds
+#if !defined(SHOSHNIKOV_POOL_CHECKED) && !defined(NDEBUG)
+#define SHOSHNIKOV_POOL_CHECKED 1
+#endif // !SHOSHNIKOV_POOL_CHECKED and !NDEBUG
+
 namespace dbj::nanolib {
 
-    /// DBJ ADDED WARNING
-    /// there is no free bellow 
-    /// blocks taken are not freed
+    /// DBJ added
+    /// blocks taken are recorded, freed by the destructor
+    /// and by release_unused()
 
 /**
  * Pool-allocator.
@@ -43,33 +53,108 @@ struct Chunk {
  * Features:
  *
  *   - Parametrized by number of chunks per block
+ *   - DBJ added: and by the chunk size, it is the same for all the blocks
  *   - Keeps track of the allocation pointer
  *   - Bump-allocates chunks
  *   - Requests a new larger block when needed
+ *   - DBJ added: gives the blocks back, see release_unused()
  *
  */
 class PoolAllocator {
  public:
-  PoolAllocator(size_t chunksPerBlock) : mChunksPerBlock(chunksPerBlock) {}
+  /**
+   * DBJ added: the chunk size is fixed here, not by the first allocate,
+   * rounded up to hold the `Chunk` and to keep it aligned.
+   */
+  PoolAllocator(size_t chunksPerBlock, size_t chunkSize)
+      : mChunksPerBlock(chunksPerBlock),
+        mChunkSize(chunkSize < sizeof(Chunk)
+                       ? sizeof(Chunk)
+                       : (chunkSize + alignof(Chunk) - 1) & ~(alignof(Chunk) - 1)) {}
+
+  /**
+   * DBJ added
+   * All the blocks are given back to the system.
+   */
+  ~PoolAllocator();
+
+  /**
+   * DBJ added
+   * The blocks are owned, no copy no move.
+   */
+  PoolAllocator(PoolAllocator const &) = delete;
+  PoolAllocator &operator=(PoolAllocator const &) = delete;
 
+  /**
+   * DBJ added: size must fit in the chunk, with SHOSHNIKOV_POOL_CHECKED
+   * larger sizes are rejected, null is returned.
+   */
   void *allocate(size_t size);
   void deallocate(void *ptr/*, size_t size*/);
 
+  size_t chunk_size() const { return mChunkSize; }
+
+  /**
+   * DBJ added
+   * Blocks with no chunk in use are given back to the system,
+   * returns how many. The free list is walked twice, thus this
+   * is not cheap, but allocate and deallocate pay nothing for it.
+   */
+  size_t release_unused();
+
+  /**
+   * DBJ added
+   * Blocks taken from the system and not given back, and their bytes.
+   */
+  size_t block_count() const { return mBlocks.size(); }
+  size_t footprint() const;
+
  private:
+  /**
+   * DBJ added
+   * A larger block, as taken from the system.
+   */
+  struct Block {
+    char *start;
+    size_t size;
+    /**
+     * Counted by release_unused() only.
+     */
+    size_t freeChunks;
+  };
+
   /**
    * Number of chunks per larger block.
    */
   size_t mChunksPerBlock;
 
+  /**
+   * DBJ added
+   * Size of every chunk in every block.
+   */
+  size_t mChunkSize;
+
   /**
    * Allocation pointer.
    */
   Chunk *mAlloc = nullptr;
 
+  /**
+   * DBJ added
+   * All the blocks, sorted by the start address.
+   */
+  std::vector<Block> mBlocks;
+
   /**
    * Allocates a larger block (pool) for chunks.
    */
-  Chunk *allocateBlock(size_t chunkSize);
+  Chunk *allocateBlock();
+
+  /**
+   * DBJ added
+   * The block of the chunk, binary search.
+   */
+  Block *blockOf(void *chunk);
 };
 
 // -----------------------------------------------------------
@@ -79,12 +164,14 @@ class PoolAllocator {
  *
  * Returns a Chunk pointer set to the beginning of the block.
  */
-Chunk *PoolAllocator::allocateBlock(size_t chunkSize) {
+Chunk *PoolAllocator::allocateBlock() {
 
+  const size_t chunkSize = mChunkSize;
   size_t blockSize = mChunksPerBlock * chunkSize;
 
   // The first chunk of the new block.
-  Chunk *blockBegin = DBJ_NANO_CALLOC( Chunk, blockSize );
+  // DBJ: blockSize is in bytes, not in Chunk's
+  Chunk *blockBegin = reinterpret_cast<Chunk *>(DBJ_NANO_CALLOC( char, blockSize ));
 
   // Once the block is allocated, we need to chain all
   // the chunks in this block:
@@ -99,9 +186,89 @@ Chunk *PoolAllocator::allocateBlock(size_t chunkSize) {
 
   chunk->next = nullptr;
 
+  // DBJ added
+  Block block{reinterpret_cast<char *>(blockBegin), blockSize, 0};
+  mBlocks.insert(
+      std::upper_bound(mBlocks.begin(), mBlocks.end(), block,
+                       [](Block const &a, Block const &b) { return a.start < b.start; }),
+      block);
+
   return blockBegin;
 }
 
+/**
+ * DBJ added
+ */
+PoolAllocator::~PoolAllocator() {
+  for (Block &block : mBlocks) {
+    DBJ_NANO_FREE(block.start);
+  }
+}
+
+/**
+ * DBJ added
+ */
+PoolAllocator::Block *PoolAllocator::blockOf(void *chunk) {
+  auto next = std::upper_bound(
+      mBlocks.begin(), mBlocks.end(), reinterpret_cast<char *>(chunk),
+      [](char *address, Block const &block) { return address < block.start; });
+  _ASSERTE(next != mBlocks.begin());
+  return &*(next - 1);
+}
+
+/**
+ * DBJ added
+ *
+ * Free chunks are counted per block. Chunks of the blocks with
+ * all the chunks free are taken out of the free list, the order of
+ * the rest is kept. Then the blocks are freed.
+ */
+size_t PoolAllocator::release_unused() {
+
+  for (Block &block : mBlocks) {
+    block.freeChunks = 0;
+  }
+
+  for (Chunk *chunk = mAlloc; chunk != nullptr; chunk = chunk->next) {
+    blockOf(chunk)->freeChunks += 1;
+  }
+
+  auto unused = [&](Block const &block) {
+    return block.freeChunks == mChunksPerBlock;
+  };
+
+  Chunk **link = &mAlloc;
+  while (*link != nullptr) {
+    if (unused(*blockOf(*link))) {
+      *link = (*link)->next;
+    } else {
+      link = &(*link)->next;
+    }
+  }
+
+  size_t released = 0;
+  for (Block &block : mBlocks) {
+    if (unused(block)) {
+      DBJ_NANO_FREE(block.start);
+      released += 1;
+    }
+  }
+
+  mBlocks.erase(std::remove_if(mBlocks.begin(), mBlocks.end(), unused), mBlocks.end());
+  return released;
+}
+
+/**
+ * DBJ added
+ */
+size_t PoolAllocator::footprint() const {
+  size_t bytes = 0;
+  for (Block const &block : mBlocks) {
+    bytes += block.size;
+  }
+  return bytes;
+}
+
 /**
  * Returns the first free chunk in the block.
  *
@@ -110,11 +277,21 @@ Chunk *PoolAllocator::allocateBlock(size_t chunkSize) {
  */
 void *PoolAllocator::allocate(size_t size) {
 
+  // DBJ added
+#ifdef SHOSHNIKOV_POOL_CHECKED
+  if (size > mChunkSize) {
+    _ASSERTE(!"allocation size is larger than the chunk size");
+    return nullptr;
+  }
+#else
+  (void)size;
+#endif // SHOSHNIKOV_POOL_CHECKED
+
   // No chunks left in the current block, or no any block
-  // exists yet. Allocate a new one, passing the chunk size:
+  // exists yet. Allocate a new one, of the chunk size:
 
   if (mAlloc == nullptr) {
-    mAlloc = allocateBlock(size);
+    mAlloc = allocateBlock();
   }
 
   // The return value is the current position of
@@ -182,7 +359,7 @@ struct Object {
 
 // Instantiate our allocator, using 8 chunks per block:
 
-PoolAllocator Object::allocator{8};
+PoolAllocator Object::allocator{8, sizeof(Object)};
 
 int test_pool_allocator (int argc, char const *argv[]) {
 
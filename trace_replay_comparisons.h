@@ -0,0 +1,182 @@
+#pragma once
+
+/// ---------------------------------------------------------------------
+/// synthetic loops do not resemble real programs
+/// here a recorded allocation trace is replayed against each allocator
+/// see dbj_benchmarking/allocation_trace.h for the format and producers
+///
+/// the trace file is taken from the DBJ_TRACE_FILE environment variable
+/// if that is not set, a synthetic trace is made and used, it is written
+/// to DBJ_SYNTHETIC_TRACE, if that is not set: dbj_synthetic.trace
+///
+/// replay is single threaded, in the order of the records
+/// the thread field is kept in the trace but not used in here
+///
+#define MEM_ALLOC_TRACE_REPLAY_COMPARISONS
+#ifdef MEM_ALLOC_TRACE_REPLAY_COMPARISONS
+
+#include <type_traits>
+#include <vector>
+
+#include "comparisons.h"
+#include "dbj_benchmarking/allocation_trace.h"
+#include "dbj_benchmarking/process_memory.h"
+
+namespace trace_replay_comparisons {
+
+	/// if DBJ_SYNTHETIC_TRACE is not set
+	constexpr const char* synthetic_trace_path = "dbj_synthetic.trace";
+#ifdef NDEBUG
+	constexpr size_t synthetic_allocations = 0x80000;
+#else
+	constexpr size_t synthetic_allocations = 0x10000;
+#endif // NDEBUG
+
+	/// RSS is sampled every that many records, outside of the timed segments
+	constexpr size_t rss_sampling_ops = 0x1000;
+	constexpr size_t page_size = 0x1000;
+
+	struct replay_result final {
+		double seconds{};
+		size_t peak_live_bytes{};
+		size_t peak_rss_growth{};
+		/// allocate() returned null, the allocator was exhausted
+		size_t failed{};
+	};
+
+	/// ---------------------------------------------------------------------
+	/// every page of the allocated block is touched, as real programs do,
+	/// otherwise RSS would not show what was taken
+	template<typename A>
+	inline replay_result replay(dbj::trace::trace_view const& trace_, A& adapter_)
+	{
+		using engine = dbj::timing::engine;
+		using dbj::trace::operation;
+
+		/// as malloc would, alignof(max_align_t), if the allocator can
+		constexpr size_t max_align_ = dbj::bench::adapter_traits<A>::max_align;
+
+		std::vector<void*> live_(trace_.id_count(), nullptr);
+		std::vector<uint32_t> sizes_(trace_.id_count(), 0);
+
+		replay_result rez_{};
+		size_t live_bytes_{};
+		double elapsed_ns_{};
+		const size_t rss_before_ = dbj::process_memory::current_rss();
+
+		auto sample_rss = [&] {
+			const size_t rss_ = dbj::process_memory::current_rss();
+			if (rss_ > rss_before_ && rss_ - rss_before_ > rez_.peak_rss_growth)
+				rez_.peak_rss_growth = rss_ - rss_before_;
+		};
+
+		const dbj::trace::record* cursor_ = trace_.begin();
+		const dbj::trace::record* const end_ = trace_.end();
+
+		while (cursor_ != end_) {
+			const dbj::trace::record* segment_end_ =
+				size_t(end_ - cursor_) > rss_sampling_ops ? cursor_ + rss_sampling_ops : end_;
+
+			const dbj::timing::tick_type start_ = engine::start();
+			for (; cursor_ != segment_end_; ++cursor_) {
+				const uint32_t id_ = cursor_->id;
+				if (cursor_->op == operation::allocate) {
+					char* block_ = (char*)adapter_.allocate(cursor_->size, max_align_);
+					if (block_ == nullptr) {
+						++rez_.failed;
+						continue;
+					}
+					for (size_t k = 0; k < cursor_->size; k += page_size) block_[k] = char(k);
+					live_[id_] = block_;
+					sizes_[id_] = cursor_->size;
+					live_bytes_ += cursor_->size;
+					if (live_bytes_ > rez_.peak_live_bytes) rez_.peak_live_bytes = live_bytes_;
+				}
+				else if (live_[id_]) {
+					adapter_.deallocate(live_[id_], sizes_[id_]);
+					live_[id_] = nullptr;
+					live_bytes_ -= sizes_[id_];
+				}
+			}
+			elapsed_ns_ += engine::elapsed_ns(start_, engine::stop());
+
+			sample_rss();
+		}
+
+		// whatever the trace left alive
+		for (size_t j = 0; j < live_.size(); ++j)
+			if (live_[j]) adapter_.deallocate(live_[j], sizes_[j]);
+
+		rez_.seconds = elapsed_ns_ / 1e9;
+		return rez_;
+	}
+
+	/// ---------------------------------------------------------------------
+	/// fragmentation is the part of the RSS growth which was not live data
+	inline void reporter(const char* name, replay_result const& rez_)
+	{
+		const double fragmentation_ = rez_.peak_rss_growth > rez_.peak_live_bytes
+			? 1.0 - double(rez_.peak_live_bytes) / double(rez_.peak_rss_growth)
+			: 0.0;
+
+		DBJ_PRINT(DBJ_FG_RED_BOLD "%-22s" DBJ_RESET " total time: %8.3f sec, peak live: %8zu KB, peak RSS growth: %8zu KB, fragmentation: %6.2f%%",
+			name, rez_.seconds, rez_.peak_live_bytes / 1024, rez_.peak_rss_growth / 1024, 100 * fragmentation_);
+
+		dbj::results::sink().add({ "trace_replay", name, 0, 1, {},
+			{ { "seconds", rez_.seconds }, { "peak_live_bytes", double(rez_.peak_live_bytes) },
+			  { "peak_rss_growth_bytes", double(rez_.peak_rss_growth) }, { "fragmentation", fragmentation_ },
+			  { "failed", double(rez_.failed) } } });
+		if (rez_.failed)
+			DBJ_PRINT("%-22s " DBJ_FG_RED_BOLD "%zu allocations failed" DBJ_RESET, " ", rez_.failed);
+	}
+
+	template<typename A>
+	inline void specimen(dbj::trace::trace_view const& trace_, A& adapter_)
+	{
+		dbj::process_memory::trim_system_heap();
+		reporter(adapter_.name(), replay(trace_, adapter_));
+	}
+
+	/// ---------------------------------------------------------------------
+	/// fixed size pools can not serve a trace of mixed sizes
+	/// they are not in here
+	/// every adapter is a fresh instance, KMEM is thus a fresh arena
+	inline void compare_replay_mechanisms(dbj::trace::trace_view const& trace_)
+	{
+		allocator_adapters::registry<sizeof(void*)>::for_each(
+			[&](auto& adapter_) {
+				using A = std::decay_t<decltype(adapter_)>;
+				if constexpr (dbj::bench::adapter_traits<A>::general_purpose)
+					specimen(trace_, adapter_);
+			});
+	}
+
+	/// ---------------------------------------------------------------------
+	inline void trace_replay_comparator()
+	{
+		const char* trace_path_ = getenv("DBJ_TRACE_FILE");
+		if (!trace_path_) {
+			trace_path_ = getenv("DBJ_SYNTHETIC_TRACE");
+			if (!trace_path_) trace_path_ = synthetic_trace_path;
+			dbj::trace::write_synthetic_trace(trace_path_, synthetic_allocations);
+		}
+
+		dbj::trace::trace_view trace_(trace_path_);
+
+		DBJ_PRINT(" ");
+		if (!trace_.valid()) {
+			DBJ_PRINT(DBJ_FG_RED_BOLD "Could not map the allocation trace: %s" DBJ_RESET, trace_path_);
+			return;
+		}
+		DBJ_PRINT("Replaying the allocation trace: %s", trace_path_);
+		DBJ_PRINT("%zu records, %zu block ids", trace_.size(), trace_.id_count());
+		DBJ_PRINT(" ");
+		dbj::timing::warm_up();
+		compare_replay_mechanisms(trace_);
+	}
+
+	TUF_REG(trace_replay_comparator);
+
+} // namespace trace_replay_comparisons
+
+#endif // MEM_ALLOC_TRACE_REPLAY_COMPARISONS